@@ -1,42 +1,70 @@
-#ifndef __LRCU_USER_DEFINES_H__
-#define __LRCU_USER_DEFINES_H__
-
-enum{
-    LRCU_NS_DEFAULT = 0,
-    /* add your own namespaces here */
-    LRCU_NS_MAX, /* but no more than 255 */
-};
-
-#define LRCU_THREADS_MAX 128
-
-/* time between worker cycles */
-#define LRCU_WORKER_SLEEP_US    50
-/* time between synchronize waiting loop */
-#define LRCU_NS_SYNC_SLEEP_US   100
-/* hang detection mechanism to prevent complete malfunction */
-#define LRCU_HANG_TIMEOUT_S     600
-
-//#define LRCU_LIST_ATOMIC
-#define LRCU_LIST_DEBUG
-
-/***********************************************************/
-/* OS api abstraction layer */
-
-#if defined(__KERNEL__)
-#define LRCU_LINUX
-#else
-#define LRCU_USER
-#endif
-
-#include "types.h"
-
-#ifdef LRCU_LINUX
-#include "linux.h"
-#else
-#include "user.h"
-#endif
-
-#include "compiler.h"
-#include "list.h"
-
+#ifndef __LRCU_USER_DEFINES_H__
+#define __LRCU_USER_DEFINES_H__
+
+enum{
+    LRCU_NS_DEFAULT = 0,
+    /* add your own namespaces here */
+    LRCU_NS_MAX, /* but no more than 255 */
+};
+
+#define LRCU_THREADS_MAX 128
+
+/* time between worker cycles */
+#define LRCU_WORKER_SLEEP_US    50
+/* worker backs off up to this while callbacks wait for readers */
+#define LRCU_WORKER_SLEEP_MAX_US    1000
+/* worker with no callbacks parks until woken, but no longer than this */
+#define LRCU_WORKER_PARK_US     1000000
+/* time between synchronize waiting loop */
+#define LRCU_NS_SYNC_SLEEP_US   100
+/* cpu_relax() rounds expedited synchronize spins before falling back */
+#define LRCU_EXPEDITED_SPINS    16384
+/* hang detection mechanism to prevent complete malfunction */
+#define LRCU_HANG_TIMEOUT_S     600
+/* hazard pointer slots per thread per namespace */
+#define LRCU_HAZARDS_MAX        4
+/* callback batches waiting per namespace, newer ones merge into the last */
+#define LRCU_CALL_SEGMENTS      64
+/* callback records a thread takes from the shared pool at once */
+#define LRCU_CALL_POOL_BATCH    64
+
+//#define LRCU_LIST_ATOMIC
+/* asserts in inline read-side fast path */
+//#define LRCU_DEBUG
+/* list loop checks walk the whole list on every operation */
+#ifdef LRCU_DEBUG
+#define LRCU_LIST_DEBUG
+#endif
+
+/***********************************************************/
+/* OS api abstraction layer */
+
+#if defined(__KERNEL__)
+#define LRCU_LINUX
+#else
+#define LRCU_USER
+#endif
+
+#include "types.h"
+
+#ifdef LRCU_LINUX
+#include "linux.h"
+#else
+#include "user.h"
+#endif
+
+#include "compiler.h"
+#include "list.h"
+
+#ifdef LRCU_DEBUG
+#define LRCU_DEBUG_ASSERT(cond) LRCU_ASSERT(cond)
+#else
+#define LRCU_DEBUG_ASSERT(cond)
+#endif
+
+/* read_lock/read_unlock are inlined from lrcu.h. needs exported TLS */
+#ifdef LRCU_USER
+#define LRCU_READ_INLINE
+#endif
+
 #endif /* __LRCU_USER_DEFINES_H__ */
\ No newline at end of file
@@ -1,174 +1,709 @@
-/* 
-	https://github.com/grumm/light-rcu
-	Andrei Dubasov - andrew.dubasov@gmail.com
-*/
-
-#ifndef _LRCU_API_H
-#define _LRCU_API_H
-/*
-    Lazy RCU: extra light read section and hard write section
-    locks taken only on lrcu_ptr  
-*/
-
-/*
-    lrcu_thread_info->lrcu_ptr_ns->lrcu_ptr
-                                 ->lrcu_ptr
-                    ->lrcu_ptr_ns->lrcu_ptr
-                                 ->lrcu_ptr
-    each thread has to have local version - which section thread in
-    (global)lrcu_ptr's have their version. thread accesses
-*/
-
-/***********************************************************/
-
-typedef void (lrcu_destructor_t)(void *); /* no typedef forward declarations */
-
-#include "defines.h"
-
-struct lrcu_ptr {
-    void *ptr; /* actual data behind pointer */
-    lrcu_destructor_t *deinit;
-    /* what about when version wraps -1? 
-        u64 would last at least after 143 years on 4Ghz CPU in ticks :) */
-    u64 version;
-    u8 ns_id;
-};
-
-typedef struct lrcu_ptr_head {
-    lrcu_list_t list;
-    lrcu_destructor_t *func;
-    u64 version;
-    u8 ns_id; //?
-} lrcu_ptr_head_t;
-
-
-/***********************************************************/
-
-#define lrcu_write_barrier() lrcu_write_barrier_ns(LRCU_NS_DEFAULT)
-
-void lrcu_write_barrier_ns(u8 ns_id);
-
-/***********************************************************/
-
-#define lrcu_write_lock() lrcu_write_lock_ns(LRCU_NS_DEFAULT)
-
-void lrcu_write_lock_ns(u8 ns_id);
-
-/***********************************************************/
-
-#define lrcu_write_unlock() lrcu_write_unlock_ns(LRCU_NS_DEFAULT)
-
-void lrcu_write_unlock_ns(u8 ns_id);
-
-/***********************************************************/
-
-#define lrcu_read_lock() lrcu_read_lock_ns(LRCU_NS_DEFAULT)
-
-void lrcu_read_lock_ns(u8 ns_id);
-
-/***********************************************************/
-
-#define lrcu_dereference(p) __lrcu_dereference((void **)&(p))
-
-void *__lrcu_dereference(void **p);
-
-void *lrcu_dereference_ptr(struct lrcu_ptr *ptr);
-
-/***********************************************************/
-
-#define lrcu_assign_pointer(p, v) __lrcu_assign_pointer_ns(LRCU_NS_DEFAULT, (void **)&(p), (v))
-
-#define lrcu_assign_pointer_ns(ns, p, v) __lrcu_assign_pointer_ns((ns), (void **)&(p), (v))
-
-void __lrcu_assign_pointer_ns(u8 ns_id, void **pp, void *newptr);
-
-void lrcu_assign_ptr(struct lrcu_ptr *ptr, void *newptr);
-
-void __lrcu_assign_ptr(struct lrcu_ptr *ptr, void *newptr);
-
-/***********************************************************/
-
-/* already allocated ptr */
-void lrcu_ptr_init(struct lrcu_ptr *ptr, u8 ns_id, 
-                            lrcu_destructor_t *deinit);
-
-/***********************************************************/
-
-#define lrcu_read_unlock() lrcu_read_unlock_ns(LRCU_NS_DEFAULT)
-
-void lrcu_read_unlock_ns(u8 ns_id);
-
-/***********************************************************/
-
-#define lrcu_call(x, y) lrcu_call_ns(LRCU_NS_DEFAULT, (x), (y))
-
-/* x - lrcu_ptr */
-#define lrcu_call_ptr(x) lrcu_call_ns((x)->ns_id, (x)->ptr, (x)->deinit)
-
-void lrcu_call_ns(u8 ns_id, void *p, lrcu_destructor_t *destr);
-
-/***********************************************************/
-
-#define lrcu_call_head(ptr, func) \
-        lrcu_call_head_ns(LRCU_NS_DEFAULT, (ptr), (func))
-
-void lrcu_call_head_ns(u8 ns_id, struct lrcu_ptr_head *head,
-                                    lrcu_destructor_t *destr);
-
-/***********************************************************/
-
-#define lrcu_synchronize() lrcu_synchronize_ns(LRCU_NS_DEFAULT)
-
-void lrcu_synchronize_ns(u8 ns_id);
-
-/***********************************************************/
-
-#define lrcu_barrier() lrcu_barrier_ns(LRCU_NS_DEFAULT)
-
-void lrcu_barrier_ns(u8 ns_id);
-
-/***********************************************************/
-
-struct lrcu_handler;
-
-struct lrcu_handler *lrcu_init(void);
-
-struct lrcu_handler *__lrcu_init(void);
-
-void lrcu_deinit(void);
-
-/***********************************************************/
-
-struct lrcu_namespace;
-
-struct lrcu_namespace *lrcu_ns_init(u8 id);
-
-void lrcu_ns_deinit(u8 id);
-
-void lrcu_ns_deinit_safe(u8 id);
-
-/***********************************************************/
-
-/* same as __X, but also set thread to deafult ns */
-struct lrcu_thread_info;
-
-struct lrcu_thread_info *lrcu_thread_init(void);
-
-struct lrcu_thread_info *__lrcu_thread_init(void);
-
-/***********************************************************/
-
-bool lrcu_thread_set_ns(u8 ns_id);
-
-bool lrcu_thread_del_ns(u8 ns_id);
-
-/***********************************************************/
-
-void lrcu_thread_deinit(void);
-
-/***********************************************************/
-
-//extern struct lrcu_handler *__lrcu_handler;
-//extern __thread struct lrcu_thread_info *__lrcu_thread_info;
-
+/* 
+	https://github.com/grumm/light-rcu
+	Andrei Dubasov - andrew.dubasov@gmail.com
+*/
+
+#ifndef _LRCU_API_H
+#define _LRCU_API_H
+/*
+    Lazy RCU: extra light read section and hard write section
+    locks taken only on lrcu_ptr  
+*/
+
+/*
+    lrcu_thread_info->lrcu_ptr_ns->lrcu_ptr
+                                 ->lrcu_ptr
+                    ->lrcu_ptr_ns->lrcu_ptr
+                                 ->lrcu_ptr
+    each thread has to have local version - which section thread in
+    (global)lrcu_ptr's have their version. thread accesses
+*/
+
+/***********************************************************/
+
+typedef void (lrcu_destructor_t)(void *); /* no typedef forward declarations */
+
+#include "defines.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct lrcu_ptr {
+    void *ptr; /* actual data behind pointer */
+    lrcu_destructor_t *deinit;
+    /* what about when version wraps -1? 
+        u64 would last at least after 143 years on 4Ghz CPU in ticks :) */
+    u64 version;
+    u8 ns_id;
+};
+
+typedef struct lrcu_ptr_head {
+    lrcu_list_t list;
+    lrcu_destructor_t *func;
+    u64 version;
+    /*
+        references from lrcu_dereference_get(). -1 - nobody holds it.
+        only read for heads retired with lrcu_call_head_ref_ns()
+    */
+    i32 refcount;
+    u8 ns_id; //?
+} lrcu_ptr_head_t;
+
+/* how read section is ordered against the worker. chosen at lrcu_ns_init */
+enum {
+    /* mb() on read_lock. default */
+    LRCU_FLAVOR_FENCE = 0,
+    /*
+        compiler barriers only on read side, worker issues membarrier()
+        once per scan. falls back to LRCU_FLAVOR_FENCE if unavailable
+    */
+    LRCU_FLAVOR_MEMBARRIER,
+    /*
+        quiescent state based. read_lock/read_unlock do nothing, thread
+        holds no pointers only when it calls lrcu_quiescent_state_ns()
+        or is offline
+    */
+    LRCU_FLAVOR_QSBR,
+    /*
+        readers count themselves in per-cpu counters, worker sums them.
+        threads do not need lrcu_thread_init(), scan is O(nr_cpus)
+    */
+    LRCU_FLAVOR_PERCPU,
+    /*
+        per-cpu counters as LRCU_FLAVOR_PERCPU, but lrcu_read_lock_sleepable_ns()
+        returns epoch to unlock with, so reader keeps no state, can sleep
+        and be unlocked on another thread. never considered hung
+    */
+    LRCU_FLAVOR_SLEEPABLE,
+    LRCU_FLAVOR_MAX,
+};
+
+typedef struct lrcu_local_namespace {
+    u64 version;
+    i32 counter; /* max nesting depth 2^32 */
+} lrcu_local_namespace_t;
+
+/*
+    lrcu_synchronize_ns()/lrcu_barrier_ns() callers sleeping in a
+    namespace. Outermost read_unlock with version <= version wakes them.
+    Unlock does not issue full barrier, so a wakeup could be missed,
+    waiters sleep no longer than ns->sync_timeout anyway.
+*/
+struct lrcu_sync_wait {
+    u32 armed; /* some waiter is going to sleep */
+    u32 seq; /* futex word */
+    u64 version; /* oldest version waited for, 0 - none */
+} LRCU_ALIGNED;
+
+void __lrcu_sync_wake(struct lrcu_sync_wait *w);
+
+static inline void lrcu_sync_wake_check(struct lrcu_sync_wait *w,
+                                                    u64 version){
+    if(unlikely(ACCESS_ONCE(w->armed)) && version <= ACCESS_ONCE(w->version))
+        __lrcu_sync_wake(w);
+}
+
+/*
+    LRCU_FLAVOR_FENCE and LRCU_FLAVOR_MEMBARRIER outermost read_lock marks
+    thread's group of readers, so the worker scans only groups entered
+    since its last look. Mark goes after counter and version, the scanner
+    clears flags before it looks at counters:
+    - reader that still finds the flag set has its counter seen by the
+      scan that clears it, and that scan keeps the group marked while
+      anybody in it is in section;
+    - reader that finds it cleared sets it before its protected loads,
+      and those loads see whatever was unpublished before the scan.
+    FENCE orders both sides with mb(), MEMBARRIER with the scanner's
+    membarrier(). Written only when cleared, so the line stays shared
+    otherwise.
+*/
+#define LRCU_FLAVOR_MARKS_LEAF(f) \
+        ((f) == LRCU_FLAVOR_FENCE || (f) == LRCU_FLAVOR_MEMBARRIER)
+
+/* tests pause a reader between its counter store and the mark */
+#ifndef LRCU_READ_MARK_STALL
+#define LRCU_READ_MARK_STALL()
+#endif
+
+/* after counter and version, and after mb() for FENCE */
+static inline void lrcu_leaf_mark_dirty(u32 *dirty, int flavor){
+    LRCU_READ_MARK_STALL();
+    if(dirty && !ACCESS_ONCE(*dirty)){
+        ACCESS_ONCE(*dirty) = 1;
+        if(flavor == LRCU_FLAVOR_FENCE)
+            mb(); /* mark before protected loads */
+    }
+    barrier();
+}
+
+/*
+    Per-thread copy of what read section needs, so that inline
+    lrcu_read_lock_ns() does not touch handler and namespace pointers.
+    Filled by lrcu_thread_set_ns(), or on first read_lock if empty.
+    Namespace destruction bumps __lrcu_ns_gen[ns_id], so caches of other
+    threads that still point into freed namespace are refilled.
+*/
+struct lrcu_read_cache {
+    struct lrcu_local_namespace *lns; /* &ti->lns[ns_id] */
+    u64 *version; /* &ns->version */
+    struct lrcu_namespace *ns;
+    struct lrcu_sync_wait *wait; /* &ns->sync_wait */
+    u32 *dirty; /* thread's leaf flag, see LRCU_FLAVOR_MARKS_LEAF */
+    int flavor;
+    u32 gen; /* __lrcu_ns_gen[ns_id] of cached namespace */
+};
+
+#ifdef LRCU_READ_INLINE
+LRCU_TLS_DECLARE(struct lrcu_read_cache, __lrcu_read_cache[LRCU_NS_MAX]);
+extern u32 __lrcu_ns_gen[LRCU_NS_MAX];
+
+/* cache belongs to namespace that is still alive */
+static inline bool lrcu_read_cache_valid(struct lrcu_read_cache *rc, u8 ns_id){
+    return likely(rc->gen == ACCESS_ONCE(__lrcu_ns_gen[ns_id]));
+}
+#endif
+
+
+/***********************************************************/
+
+/*
+    Moves namespace version on. Writers do not need it: synchronize, the
+    worker and grace period polling move it when a grace period starts.
+*/
+#define lrcu_write_barrier() lrcu_write_barrier_ns(LRCU_NS_DEFAULT)
+
+void lrcu_write_barrier_ns(u8 ns_id);
+
+/***********************************************************/
+
+#define lrcu_write_lock() lrcu_write_lock_ns(LRCU_NS_DEFAULT)
+
+void lrcu_write_lock_ns(u8 ns_id);
+
+/***********************************************************/
+
+#define lrcu_write_unlock() lrcu_write_unlock_ns(LRCU_NS_DEFAULT)
+
+void lrcu_write_unlock_ns(u8 ns_id);
+
+/***********************************************************/
+
+#define lrcu_read_lock() lrcu_read_lock_ns(LRCU_NS_DEFAULT)
+
+/* out-of-line version. looks up namespace and fills read cache */
+void __lrcu_read_lock_ns(u8 ns_id);
+
+#ifdef LRCU_READ_INLINE
+static inline void lrcu_read_lock_ns(u8 ns_id){
+    struct lrcu_read_cache *rc = &LRCU_TLS_GET(__lrcu_read_cache)[ns_id];
+    struct lrcu_local_namespace *lns = rc->lns;
+
+    LRCU_DEBUG_ASSERT(ns_id < LRCU_NS_MAX);
+    if(unlikely(!lrcu_read_cache_valid(rc, ns_id))){
+        __lrcu_read_lock_ns(ns_id);
+        return;
+    }
+    if(unlikely(rc->flavor >= LRCU_FLAVOR_QSBR)){
+        if(rc->flavor != LRCU_FLAVOR_QSBR)
+            __lrcu_read_lock_ns(ns_id);
+        return;
+    }
+    if(unlikely(lns == NULL)){
+        __lrcu_read_lock_ns(ns_id);
+        return;
+    }
+
+    lns->counter++; /* can be nested! */
+    barrier(); /* counter first, version after. see worker thread read order */
+    if(likely(lns->counter == 1)){
+        lns->version = ACCESS_ONCE(*rc->version);
+        /* barrier for worker thread to see new version, then the mark */
+        if(rc->flavor == LRCU_FLAVOR_MEMBARRIER)
+            barrier(); /* worker's membarrier() does the rest */
+        else
+            mb();
+        lrcu_leaf_mark_dirty(rc->dirty, rc->flavor);
+    }
+}
+#else
+#define lrcu_read_lock_ns(ns_id) __lrcu_read_lock_ns(ns_id)
+#endif
+
+/***********************************************************/
+
+#define lrcu_dereference(p) __lrcu_dereference((void **)&(p))
+
+void *__lrcu_dereference(void **p);
+
+void *lrcu_dereference_ptr(struct lrcu_ptr *ptr);
+
+/*
+    Reference upgrade for objects with lrcu_ptr_head. Inside read section
+    lrcu_dereference_get() takes a reference, so object stays valid after
+    lrcu_read_unlock() until lrcu_ptr_head_put(). Opt-in: head must be
+    lrcu_ptr_head_init()'ed before publishing and retired with
+    lrcu_call_head_ref_ns(). Object is destroyed once both grace period
+    is over and last reference is put, by the worker or by the last put.
+    member - lrcu_ptr_head field of *p
+*/
+#define lrcu_dereference_get(p, member) \
+        ((__typeof__(p))__lrcu_dereference_get((void **)&(p), \
+                                offsetof(__typeof__(*(p)), member)))
+
+#define lrcu_put(p, member) lrcu_ptr_head_put(&(p)->member)
+
+void *__lrcu_dereference_get(void **p, size_t head_offset);
+
+void lrcu_ptr_head_init(struct lrcu_ptr_head *head);
+
+/* inside read section only */
+void lrcu_ptr_head_get(struct lrcu_ptr_head *head);
+
+void lrcu_ptr_head_put(struct lrcu_ptr_head *head);
+
+/***********************************************************/
+
+/*
+    Hazard pointers. Protects one object without read section, so long or
+    blocking reader does not hold back all other callbacks of namespace.
+    Slot is 0..LRCU_HAZARDS_MAX-1, per thread and namespace. Thread has to
+    be registered in that namespace (lrcu_thread_set_ns) while it holds
+    any slot: worker reads slots of registered threads only, protecting
+    from any other thread asserts. Object stays valid until slot is
+    released or reused.
+    lrcu_call_ns() objects are matched by pointer, lrcu_call_head_ns() by
+    head, so use _head variant for them. lrcu_barrier() does not wait for
+    protected objects.
+*/
+#define lrcu_hazard_protect(slot, p) \
+        lrcu_hazard_protect_ns(LRCU_NS_DEFAULT, (slot), (p))
+
+#define lrcu_hazard_protect_ns(ns_id, slot, p) \
+        ((__typeof__(p))__lrcu_hazard_protect_ns((ns_id), (slot), \
+                                (void **)&(p), 0))
+
+#define lrcu_hazard_protect_head(slot, p, member) \
+        lrcu_hazard_protect_head_ns(LRCU_NS_DEFAULT, (slot), (p), member)
+
+#define lrcu_hazard_protect_head_ns(ns_id, slot, p, member) \
+        ((__typeof__(p))__lrcu_hazard_protect_ns((ns_id), (slot), \
+                (void **)&(p), offsetof(__typeof__(*(p)), member)))
+
+#define lrcu_hazard_release(slot) \
+        lrcu_hazard_release_ns(LRCU_NS_DEFAULT, (slot))
+
+void *__lrcu_hazard_protect_ns(u8 ns_id, u8 slot, void **p,
+                                            size_t head_offset);
+
+void lrcu_hazard_release_ns(u8 ns_id, u8 slot);
+
+/***********************************************************/
+
+#define lrcu_assign_pointer(p, v) __lrcu_assign_pointer_ns(LRCU_NS_DEFAULT, (void **)&(p), (v))
+
+#define lrcu_assign_pointer_ns(ns, p, v) __lrcu_assign_pointer_ns((ns), (void **)&(p), (v))
+
+void __lrcu_assign_pointer_ns(u8 ns_id, void **pp, void *newptr);
+
+void lrcu_assign_ptr(struct lrcu_ptr *ptr, void *newptr);
+
+void __lrcu_assign_ptr(struct lrcu_ptr *ptr, void *newptr);
+
+/*
+    Lock-free publication, for writers that do not share a lock.
+    xchg returns the old pointer, cmpxchg the one it found (old on
+    success). Both are full barriers. Winner retires what it replaced.
+*/
+#define lrcu_xchg_pointer(p, v) __lrcu_xchg_pointer((void **)&(p), (v))
+
+#define lrcu_cmpxchg_pointer(p, o, n) \
+        __lrcu_cmpxchg_pointer((void **)&(p), (o), (n))
+
+void *__lrcu_xchg_pointer(void **pp, void *newptr);
+
+void *__lrcu_cmpxchg_pointer(void **pp, void *oldptr, void *newptr);
+
+void *lrcu_xchg_ptr(struct lrcu_ptr *ptr, void *newptr);
+
+/***********************************************************/
+
+/* already allocated ptr */
+void lrcu_ptr_init(struct lrcu_ptr *ptr, u8 ns_id, 
+                            lrcu_destructor_t *deinit);
+
+/***********************************************************/
+
+#define lrcu_read_unlock() lrcu_read_unlock_ns(LRCU_NS_DEFAULT)
+
+void __lrcu_read_unlock_ns(u8 ns_id);
+
+#ifdef LRCU_READ_INLINE
+static inline void lrcu_read_unlock_ns(u8 ns_id){
+    struct lrcu_read_cache *rc = &LRCU_TLS_GET(__lrcu_read_cache)[ns_id];
+    struct lrcu_local_namespace *lns = rc->lns;
+
+    LRCU_DEBUG_ASSERT(ns_id < LRCU_NS_MAX);
+    /* ns torn down in section, counter went back to thread_info */
+    if(unlikely(!lrcu_read_cache_valid(rc, ns_id))){
+        __lrcu_read_unlock_ns(ns_id);
+        return;
+    }
+    if(unlikely(rc->flavor >= LRCU_FLAVOR_QSBR)){
+        if(rc->flavor != LRCU_FLAVOR_QSBR)
+            __lrcu_read_unlock_ns(ns_id);
+        return;
+    }
+    if(unlikely(lns == NULL)){
+        __lrcu_read_unlock_ns(ns_id);
+        return;
+    }
+
+    if(lns->counter != 1){
+        lns->counter--;
+    }else{
+        /* between protected data access and actual destruction of the object */
+        barrier();
+        lns->counter--;
+        barrier();
+        lrcu_sync_wake_check(rc->wait, lns->version);
+    }
+    LRCU_DEBUG_ASSERT(lns->counter >= 0);
+}
+#else
+#define lrcu_read_unlock_ns(ns_id) __lrcu_read_unlock_ns(ns_id)
+#endif
+
+/***********************************************************/
+
+/*
+    LRCU_FLAVOR_SLEEPABLE read section. Returns index to pass to unlock.
+    No nesting state, reader may block, migrate, or unlock from another
+    thread, and does not need lrcu_thread_init(). Sleeping reader delays
+    only its own namespace.
+*/
+int lrcu_read_lock_sleepable_ns(u8 ns_id);
+
+void lrcu_read_unlock_sleepable_ns(u8 ns_id, int idx);
+
+/***********************************************************/
+
+/*
+    Enter/leave several namespaces at once. mask is a set of LRCU_NS_BIT(),
+    so only namespaces with id < 64. Each namespace gets its usual entry,
+    but thread local cache is fetched once and a single fence is issued
+    for all of them.
+*/
+#define LRCU_NS_BIT(ns_id) (1ULL << (ns_id))
+
+void __lrcu_read_lock_set(u64 mask);
+
+void __lrcu_read_unlock_set(u64 mask);
+
+#ifdef LRCU_READ_INLINE
+static inline void lrcu_read_lock_set(u64 mask){
+    struct lrcu_read_cache *rcs = LRCU_TLS_GET(__lrcu_read_cache);
+    bool fence = false;
+    u64 marks = 0;
+
+    while(mask){
+        u8 ns_id = __builtin_ctzll(mask);
+        struct lrcu_read_cache *rc = &rcs[ns_id];
+        struct lrcu_local_namespace *lns = rc->lns;
+
+        mask &= mask - 1;
+        LRCU_DEBUG_ASSERT(ns_id < LRCU_NS_MAX);
+        if(unlikely(!lrcu_read_cache_valid(rc, ns_id))){
+            __lrcu_read_lock_ns(ns_id);
+            continue;
+        }
+        if(unlikely(rc->flavor >= LRCU_FLAVOR_QSBR || lns == NULL)){
+            if(rc->flavor != LRCU_FLAVOR_QSBR)
+                __lrcu_read_lock_ns(ns_id);
+            continue;
+        }
+
+        lns->counter++;
+        barrier(); /* counter first, version after */
+        if(likely(lns->counter == 1)){
+            lns->version = ACCESS_ONCE(*rc->version);
+            if(rc->flavor != LRCU_FLAVOR_MEMBARRIER)
+                fence = true;
+            else
+                barrier();
+            marks |= LRCU_NS_BIT(ns_id);
+        }
+    }
+    /* one fence for every namespace entered above */
+    if(fence)
+        mb();
+    else
+        barrier();
+    while(marks){
+        struct lrcu_read_cache *rc = &rcs[__builtin_ctzll(marks)];
+
+        marks &= marks - 1;
+        lrcu_leaf_mark_dirty(rc->dirty, rc->flavor);
+    }
+}
+
+static inline void lrcu_read_unlock_set(u64 mask){
+    struct lrcu_read_cache *rcs = LRCU_TLS_GET(__lrcu_read_cache);
+
+    barrier(); /* between protected data access and counters */
+    while(mask){
+        u8 ns_id = __builtin_ctzll(mask);
+        struct lrcu_read_cache *rc = &rcs[ns_id];
+        struct lrcu_local_namespace *lns = rc->lns;
+
+        mask &= mask - 1;
+        LRCU_DEBUG_ASSERT(ns_id < LRCU_NS_MAX);
+        if(unlikely(!lrcu_read_cache_valid(rc, ns_id))){
+            __lrcu_read_unlock_ns(ns_id);
+            continue;
+        }
+        if(unlikely(rc->flavor >= LRCU_FLAVOR_QSBR || lns == NULL)){
+            if(rc->flavor != LRCU_FLAVOR_QSBR)
+                __lrcu_read_unlock_ns(ns_id);
+            continue;
+        }
+
+        lns->counter--;
+        LRCU_DEBUG_ASSERT(lns->counter >= 0);
+        if(lns->counter == 0)
+            lrcu_sync_wake_check(rc->wait, lns->version);
+    }
+    barrier();
+}
+#else
+#define lrcu_read_lock_set(mask) __lrcu_read_lock_set(mask)
+#define lrcu_read_unlock_set(mask) __lrcu_read_unlock_set(mask)
+#endif
+
+/***********************************************************/
+
+/*
+    LRCU_FLAVOR_QSBR only, no-op for other flavors.
+    Thread says it does not hold any pointers from this namespace.
+*/
+#define lrcu_quiescent_state() lrcu_quiescent_state_ns(LRCU_NS_DEFAULT)
+
+void __lrcu_quiescent_state_ns(u8 ns_id);
+
+#ifdef LRCU_READ_INLINE
+static inline void lrcu_quiescent_state_ns(u8 ns_id){
+    struct lrcu_read_cache *rc = &LRCU_TLS_GET(__lrcu_read_cache)[ns_id];
+    struct lrcu_local_namespace *lns = rc->lns;
+    u64 version;
+
+    LRCU_DEBUG_ASSERT(ns_id < LRCU_NS_MAX);
+    if(unlikely(lns == NULL || !lrcu_read_cache_valid(rc, ns_id))){
+        __lrcu_quiescent_state_ns(ns_id);
+        return;
+    }
+    if(rc->flavor != LRCU_FLAVOR_QSBR)
+        return;
+
+    version = lns->version;
+    /* everything read before is not used anymore */
+    mb();
+    lns->version = ACCESS_ONCE(*rc->version);
+    lrcu_sync_wake_check(rc->wait, version);
+}
+#else
+#define lrcu_quiescent_state_ns(ns_id) __lrcu_quiescent_state_ns(ns_id)
+#endif
+
+/*
+    LRCU_FLAVOR_QSBR only. Offline thread is never waited for, e.g. before
+    blocking. Threads are online after lrcu_thread_set_ns()
+*/
+#define lrcu_thread_online() lrcu_thread_online_ns(LRCU_NS_DEFAULT)
+#define lrcu_thread_offline() lrcu_thread_offline_ns(LRCU_NS_DEFAULT)
+
+void lrcu_thread_online_ns(u8 ns_id);
+
+void lrcu_thread_offline_ns(u8 ns_id);
+
+/***********************************************************/
+
+/*
+    Read section not bound to a thread. Context is registered with one
+    namespace and can be locked on one thread and unlocked on another,
+    e.g. across co_await or fiber switch. Caller makes sure context is
+    used by one thread at a time, as with any coroutine local state.
+    Deinit it before namespace is deinitialized.
+*/
+struct lrcu_reader_ctx;
+
+struct lrcu_reader_ctx *lrcu_reader_ctx_init(u8 ns_id);
+
+void lrcu_reader_ctx_deinit(struct lrcu_reader_ctx *ctx);
+
+void lrcu_read_lock_ctx(struct lrcu_reader_ctx *ctx);
+
+void lrcu_read_unlock_ctx(struct lrcu_reader_ctx *ctx);
+
+/***********************************************************/
+
+#define lrcu_call(x, y) lrcu_call_ns(LRCU_NS_DEFAULT, (x), (y))
+
+/* x - lrcu_ptr */
+#define lrcu_call_ptr(x) lrcu_call_ns((x)->ns_id, (x)->ptr, (x)->deinit)
+
+/*
+    Out of memory for a record: waits for grace period and destroys p
+    itself, so never dropped, but then it must not run in read section.
+*/
+void lrcu_call_ns(u8 ns_id, void *p, lrcu_destructor_t *destr);
+
+/***********************************************************/
+
+#define lrcu_call_head(ptr, func) \
+        lrcu_call_head_ns(LRCU_NS_DEFAULT, (ptr), (func))
+
+void lrcu_call_head_ns(u8 ns_id, struct lrcu_ptr_head *head,
+                                    lrcu_destructor_t *destr);
+
+/* same, but keeps references of lrcu_dereference_get() in account */
+#define lrcu_call_head_ref(ptr, func) \
+        lrcu_call_head_ref_ns(LRCU_NS_DEFAULT, (ptr), (func))
+
+void lrcu_call_head_ref_ns(u8 ns_id, struct lrcu_ptr_head *head,
+                                    lrcu_destructor_t *destr);
+
+/*
+    Retire many objects at once, e.g. a whole rebuilt table. Batch takes
+    one lock and one version, worker calls destr for all of it in one go.
+    ptrs is copied. While any of the pointers is in a hazard slot the
+    whole batch waits.
+*/
+#define lrcu_call_batch(ptrs, n, destr) \
+        lrcu_call_batch_ns(LRCU_NS_DEFAULT, (ptrs), (n), (destr))
+
+void lrcu_call_batch_ns(u8 ns_id, void **ptrs, size_t n,
+                                    lrcu_destructor_t *destr);
+
+/*
+    Same for objects with lrcu_ptr_head: heads chained through
+    head->list.next, NULL terminated. Every head gets destr and is
+    destroyed like with lrcu_call_head_ns().
+*/
+#define lrcu_call_head_batch(first, destr) \
+        lrcu_call_head_batch_ns(LRCU_NS_DEFAULT, (first), (destr))
+
+void lrcu_call_head_batch_ns(u8 ns_id, struct lrcu_ptr_head *first,
+                                    lrcu_destructor_t *destr);
+
+/***********************************************************/
+
+#define lrcu_synchronize() lrcu_synchronize_ns(LRCU_NS_DEFAULT)
+
+void lrcu_synchronize_ns(u8 ns_id);
+
+/*
+    Spins on threads that were in read section at the call instead of
+    sleeping between scans. Falls back to lrcu_synchronize_ns() after
+    LRCU_EXPEDITED_SPINS, and for per-cpu flavors. Burns cpu, for rare
+    latency sensitive writers.
+*/
+#define lrcu_synchronize_expedited() lrcu_synchronize_expedited_ns(LRCU_NS_DEFAULT)
+
+void lrcu_synchronize_expedited_ns(u8 ns_id);
+
+/***********************************************************/
+
+#define lrcu_barrier() lrcu_barrier_ns(LRCU_NS_DEFAULT)
+
+void lrcu_barrier_ns(u8 ns_id);
+
+/***********************************************************/
+
+/*
+    Polled grace periods. cookie = lrcu_get_state_ns() after unpublishing
+    objects, later lrcu_poll_state_ns(cookie) tells without blocking if
+    every reader that could see them is gone, and asks the worker to find
+    out if not yet. lrcu_cond_synchronize_ns(cookie) returns at once if so,
+    otherwise is lrcu_synchronize_ns().
+*/
+#define lrcu_get_state() lrcu_get_state_ns(LRCU_NS_DEFAULT)
+#define lrcu_poll_state(c) lrcu_poll_state_ns(LRCU_NS_DEFAULT, (c))
+#define lrcu_cond_synchronize(c) lrcu_cond_synchronize_ns(LRCU_NS_DEFAULT, (c))
+
+u64 lrcu_get_state_ns(u8 ns_id);
+
+bool lrcu_poll_state_ns(u8 ns_id, u64 cookie);
+
+void lrcu_cond_synchronize_ns(u8 ns_id, u64 cookie);
+
+/***********************************************************/
+
+/*
+    Non-blocking synchronize for event loops. cb(arg) is called from the
+    worker once readers that could see data unpublished before the call
+    are gone. It is lrcu_call_ns() underneath, so lrcu_barrier_ns() waits
+    for it and arg is matched against hazard slots like any object.
+    lrcu_ns_eventfd() returns fd (nonblocking, owned by the namespace)
+    that becomes readable after worker passes that completed callbacks
+    or grace periods, -1 if not supported.
+*/
+#define lrcu_synchronize_async(cb, arg) \
+        lrcu_synchronize_async_ns(LRCU_NS_DEFAULT, (cb), (arg))
+#define lrcu_eventfd() lrcu_ns_eventfd(LRCU_NS_DEFAULT)
+
+void lrcu_synchronize_async_ns(u8 ns_id, lrcu_destructor_t *cb, void *arg);
+
+int lrcu_ns_eventfd(u8 ns_id);
+
+/***********************************************************/
+
+struct lrcu_handler;
+
+struct lrcu_handler *lrcu_init(void);
+
+struct lrcu_handler *__lrcu_init(void);
+
+void lrcu_deinit(void);
+
+/***********************************************************/
+
+struct lrcu_namespace;
+
+struct lrcu_namespace *lrcu_ns_init(u8 id);
+
+/* flavor - LRCU_FLAVOR_* */
+struct lrcu_namespace *lrcu_ns_init_flavor(u8 id, int flavor);
+
+void lrcu_ns_deinit(u8 id);
+
+void lrcu_ns_deinit_safe(u8 id);
+
+/***********************************************************/
+
+/* same as __X, but also set thread to deafult ns */
+struct lrcu_thread_info;
+
+struct lrcu_thread_info *lrcu_thread_init(void);
+
+struct lrcu_thread_info *__lrcu_thread_init(void);
+
+/***********************************************************/
+
+bool lrcu_thread_set_ns(u8 ns_id);
+
+bool lrcu_thread_del_ns(u8 ns_id);
+
+/***********************************************************/
+
+void lrcu_thread_deinit(void);
+
+/***********************************************************/
+
+//extern struct lrcu_handler *__lrcu_handler;
+//extern __thread struct lrcu_thread_info *__lrcu_thread_info;
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
\ No newline at end of file
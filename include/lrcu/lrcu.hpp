@@ -0,0 +1,154 @@
+/*
+	https://github.com/grumm/light-rcu
+	Andrei Dubasov - andrew.dubasov@gmail.com
+*/
+
+#ifndef _LRCU_API_HPP
+#define _LRCU_API_HPP
+/*
+    C++ wrappers for lrcu.h. Namespace id is a template parameter, so
+    every call uses a constant id, and destructors are generated per type
+    instead of being written by hand as void * trampolines.
+
+    lrcu::read_guard<NS> g;         -- read section for the scope
+    lrcu::ctx_read_guard g(ctx);    -- same for struct lrcu_reader_ctx
+    lrcu::ptr<T, NS> p;             -- struct lrcu_ptr holding T *
+    p.publish(new T(...));          -- assign and retire old object
+    lrcu::retire<NS>(obj);          -- lrcu_call_ns with T's deleter
+    lrcu::retire<NS, Deleter>(obj);
+    lrcu::synchronize<NS>(), lrcu::wait_callbacks<NS>()
+*/
+
+#include "lrcu.h"
+
+#include <memory>
+
+namespace lrcu {
+
+/* default deleter through lrcu_destructor_t */
+template <typename T, typename Deleter = std::default_delete<T> >
+struct destructor {
+    static void call(void *p){
+        Deleter()(static_cast<T *>(p));
+    }
+};
+
+/***********************************************************/
+
+template <u8 NS = LRCU_NS_DEFAULT>
+class read_guard {
+public:
+    read_guard(){
+        lrcu_read_lock_ns(NS);
+    }
+    ~read_guard(){
+        lrcu_read_unlock_ns(NS);
+    }
+
+private:
+    read_guard(const read_guard &);
+    read_guard &operator=(const read_guard &);
+};
+
+/* struct lrcu_reader_ctx section. may end on another thread */
+class ctx_read_guard {
+public:
+    explicit ctx_read_guard(struct lrcu_reader_ctx *ctx) : ctx_(ctx) {
+        lrcu_read_lock_ctx(ctx_);
+    }
+    ~ctx_read_guard(){
+        lrcu_read_unlock_ctx(ctx_);
+    }
+
+private:
+    ctx_read_guard(const ctx_read_guard &);
+    ctx_read_guard &operator=(const ctx_read_guard &);
+
+    struct lrcu_reader_ctx *ctx_;
+};
+
+/***********************************************************/
+
+/* Deleter is deduced as std::default_delete<T> */
+template <u8 NS, typename Deleter, typename T>
+inline void retire(T *obj){
+    if(obj)
+        lrcu_call_ns(NS, obj, &destructor<T, Deleter>::call);
+}
+
+template <u8 NS = LRCU_NS_DEFAULT, typename T>
+inline void retire(T *obj){
+    retire<NS, std::default_delete<T> >(obj);
+}
+
+template <u8 NS = LRCU_NS_DEFAULT>
+inline void synchronize(){
+    lrcu_synchronize_ns(NS);
+}
+
+/* lrcu_barrier_ns. barrier() is taken by compiler.h */
+template <u8 NS = LRCU_NS_DEFAULT>
+inline void wait_callbacks(){
+    lrcu_barrier_ns(NS);
+}
+
+/***********************************************************/
+
+/*
+    Owns the object behind the pointer. Old objects are retired through
+    lrcu_call_ns() on publish() and when ptr itself is destroyed.
+*/
+template <typename T, u8 NS = LRCU_NS_DEFAULT,
+                            typename Deleter = std::default_delete<T> >
+class ptr {
+public:
+    ptr(){
+        lrcu_ptr_init(&p, NS, &destructor<T, Deleter>::call);
+    }
+    explicit ptr(T *obj){
+        lrcu_ptr_init(&p, NS, &destructor<T, Deleter>::call);
+        p.ptr = obj;
+    }
+    ~ptr(){
+        retire<NS, Deleter>(static_cast<T *>(p.ptr));
+    }
+
+    /* read section only */
+    T *get() const {
+        T *obj = static_cast<T *>(ACCESS_ONCE(p.ptr));
+
+        read_barrier_depends();
+        return obj;
+    }
+    T *operator->() const {
+        return get();
+    }
+    T &operator*() const {
+        return *get();
+    }
+
+    /* writer. caller serializes writers (lrcu_write_lock_ns or own lock) */
+    T *exchange(T *obj){
+        T *old = static_cast<T *>(p.ptr);
+
+        lrcu_assign_ptr(&p, obj);
+        return old;
+    }
+    void publish(T *obj){
+        retire<NS, Deleter>(exchange(obj));
+    }
+
+    struct lrcu_ptr *raw(){
+        return &p;
+    }
+
+private:
+    ptr(const ptr &);
+    ptr &operator=(const ptr &);
+
+    struct lrcu_ptr p;
+};
+
+} /* namespace lrcu */
+
+#endif /* _LRCU_API_HPP */
@@ -1,77 +1,159 @@
-#ifndef __LRCU_USER_SPACE_DEFINES_H__
-#define __LRCU_USER_SPACE_DEFINES_H__
-
-/* print defines */
-
-#include <stdio.h>
-#include <assert.h>
-
-#define LRCU_LOG(...) fprintf(stdout, __VA_ARGS__)
-#define LRCU_ASSERT(cond) assert(cond)
-#define LRCU_WARN(...) fprintf(stderr, __VA_ARGS__)
-
-/* thread defines */
-
-#include <pthread.h>
-
-/* shall return NULL on success */
-#define LRCU_THREAD_CREATE(tid, func, data) pthread_create(tid, NULL, func, data)
-#define LRCU_THREAD_JOIN(ptid) pthread_join(*(ptid), NULL)
-typedef pthread_t LRCU_THREAD_T;
-#define LRCU_THREAD_SHOULD_STOP() false
-
-#define LRCU_TLS_DEFINE(t, v) static LRCU_ALIGNED __thread t v
-/* in case of pthread-only tls */
-#define LRCU_TLS_INIT(x)
-#define LRCU_TLS_DEINIT(x)
-
-#define LRCU_TLS_SET(a, b) ((a) = (b))
-#define LRCU_TLS_GET(a) (a)
-
-/* preemption things */
-#define LRCU_PREEMPT_ENABLE()
-#define LRCU_PREEMPT_DISABLE()
-
-/* misc */
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-
-#include <inttypes.h>
-#include <stdint.h>
-#include <stdbool.h>
-
-#define LRCU_CALLOC(a, b) calloc((a), (b))
-#define LRCU_MALLOC(a) malloc(a)
-#define LRCU_FREE(a) free(a)
-
-#define LRCU_QSORT(base, num, size, cmp_func) \
-		qsort((base), (num), (size), (cmp_func))
-
-#define LRCU_USLEEP(x) usleep(x)
-#define LRCU_YIELD() sched_yield()
-
-#define LRCU_EXPORT_SYMBOL(x)
-
-#define LRCU_CACHE_LINE_SIZE 64
-#define LRCU_ALIGNED __attribute__((__aligned__(LRCU_CACHE_LINE_SIZE)))
-
-/* custom define in case we need some code in object  */
-#define LRCU_OS_API_DEFINE
-
-/* time */
-#include <sys/time.h>
-
-typedef struct timeval LRCU_TIMER_TYPE;
-#define LRCU_TIMER_INIT(sec, usec) {.tv_sec = (sec), .tv_usec = (usec)}
-
-#define LRCU_TIMER_ADD(a, b, c) timeradd((a), (b), (c))
-#define LRCU_TIMER_GET(x) gettimeofday((x), NULL)
-#define LRCU_TIMER_ISSET(x) timerisset(x)
-#define LRCU_TIMER_CLEAR(x) timerclear(x)
-#define LRCU_TIMER_CMP(a, b, c) timercmp((a), (b), c)
-
-/* for testing purposes */
-#define LRCU_EXIT(x) exit(x)
-
+#ifndef __LRCU_USER_SPACE_DEFINES_H__
+#define __LRCU_USER_SPACE_DEFINES_H__
+
+/* print defines */
+
+#include <stdio.h>
+#include <assert.h>
+
+#define LRCU_LOG(...) fprintf(stdout, __VA_ARGS__)
+#define LRCU_ASSERT(cond) assert(cond)
+#define LRCU_WARN(...) fprintf(stderr, __VA_ARGS__)
+
+/* thread defines */
+
+#include <pthread.h>
+
+/* shall return NULL on success */
+#define LRCU_THREAD_CREATE(tid, func, data) pthread_create(tid, NULL, func, data)
+#define LRCU_THREAD_JOIN(ptid) pthread_join(*(ptid), NULL)
+typedef pthread_t LRCU_THREAD_T;
+#define LRCU_THREAD_SHOULD_STOP() false
+
+#define LRCU_TLS_DEFINE(t, v) static LRCU_ALIGNED __thread t v
+/* tls visible to inline functions in headers */
+#define LRCU_TLS_DEFINE_EXPORTED(t, v) LRCU_ALIGNED __thread t v
+#define LRCU_TLS_DECLARE(t, v) extern __thread t v
+/* in case of pthread-only tls */
+#define LRCU_TLS_INIT(x)
+#define LRCU_TLS_DEINIT(x)
+
+#define LRCU_TLS_SET(a, b) ((a) = (b))
+#define LRCU_TLS_GET(a) (a)
+
+/* asymmetric fences. heavy side on worker, compiler barrier on readers */
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+
+#define LRCU_MEMBARRIER_REGISTER() \
+        (syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0)
+#define LRCU_MEMBARRIER() \
+        syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0)
+#else
+#define LRCU_MEMBARRIER_REGISTER() false
+#define LRCU_MEMBARRIER() mb()
+#endif
+
+/* sleep while *addr == val, at most us. wake all sleepers on addr */
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
+#include <time.h>
+
+#define LRCU_FUTEX_WAIT(addr, val, us) ({ \
+            struct timespec __ts = { \
+                .tv_sec = (us) / 1000000, \
+                .tv_nsec = ((us) % 1000000) * 1000, \
+            }; \
+            syscall(SYS_futex, (addr), FUTEX_WAIT_PRIVATE, (val), &__ts, NULL, 0); \
+        })
+#define LRCU_FUTEX_WAKE(addr) \
+        syscall(SYS_futex, (addr), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0)
+#else
+#define LRCU_FUTEX_WAIT(addr, val, us) LRCU_USLEEP(us)
+#define LRCU_FUTEX_WAKE(addr)
+#endif
+
+/* counter fd for event loops. signal makes it readable */
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define LRCU_EVENTFD_CREATE() eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)
+#define LRCU_EVENTFD_SIGNAL(fd) ({ \
+            u64 __one = 1; \
+            (void)!write((fd), &__one, sizeof(__one)); \
+        })
+#define LRCU_EVENTFD_CLOSE(fd) close(fd)
+#else
+#define LRCU_EVENTFD_CREATE() (-1)
+#define LRCU_EVENTFD_SIGNAL(fd)
+#define LRCU_EVENTFD_CLOSE(fd)
+#endif
+
+/* cpu the thread runs on. only a hint, thread can migrate right after */
+#ifdef __linux__
+#include <sys/syscall.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35))
+/* glibc registers rseq area for every thread. kernel keeps cpu_id there */
+#include <sys/rseq.h>
+#define LRCU_RSEQ_CPU() (__rseq_size ? (int)ACCESS_ONCE(((struct rseq *) \
+            ((char *)__builtin_thread_pointer() + __rseq_offset))->cpu_id) : -1)
+#else
+#define LRCU_RSEQ_CPU() (-1)
+#endif
+
+#define LRCU_GET_CPU() ({ \
+            int __cpu = LRCU_RSEQ_CPU(); \
+            if(__cpu < 0){ \
+                unsigned __gcpu = 0; \
+                syscall(SYS_getcpu, &__gcpu, NULL, NULL); \
+                __cpu = (int)__gcpu; \
+            } \
+            __cpu; \
+        })
+#else
+#define LRCU_GET_CPU() 0
+#endif
+#define LRCU_NR_CPUS() ((u32)sysconf(_SC_NPROCESSORS_CONF))
+
+/* preemption things */
+#define LRCU_PREEMPT_ENABLE()
+#define LRCU_PREEMPT_DISABLE()
+
+/* misc */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LRCU_CALLOC(a, b) calloc((a), (b))
+#define LRCU_MALLOC(a) malloc(a)
+#define LRCU_FREE(a) free(a)
+
+#define LRCU_QSORT(base, num, size, cmp_func) \
+		qsort((base), (num), (size), (cmp_func))
+
+#define LRCU_USLEEP(x) usleep(x)
+#define LRCU_YIELD() sched_yield()
+
+#define LRCU_EXPORT_SYMBOL(x)
+
+#define LRCU_CACHE_LINE_SIZE 64
+#define LRCU_ALIGNED __attribute__((__aligned__(LRCU_CACHE_LINE_SIZE)))
+
+/* custom define in case we need some code in object  */
+#define LRCU_OS_API_DEFINE
+
+/* time */
+#include <sys/time.h>
+
+typedef struct timeval LRCU_TIMER_TYPE;
+#define LRCU_TIMER_INIT(sec, usec) {.tv_sec = (sec), .tv_usec = (usec)}
+
+#define LRCU_TIMER_ADD(a, b, c) timeradd((a), (b), (c))
+#define LRCU_TIMER_GET(x) gettimeofday((x), NULL)
+#define LRCU_TIMER_ISSET(x) timerisset(x)
+#define LRCU_TIMER_CLEAR(x) timerclear(x)
+#define LRCU_TIMER_CMP(a, b, c) timercmp((a), (b), c)
+
+/* for testing purposes */
+#define LRCU_EXIT(x) exit(x)
+
 #endif /* __LRCU_USER_SPACE_DEFINES_H__ */
\ No newline at end of file
@@ -1,945 +1,2791 @@
-/*
-    Lazy RCU: extra light read section and hard write section
-    locks taken only on lrcu_ptr  
-*/
-
-#include <lrcu/lrcu.h>
-#include "lrcu_internal.h"
-#include "range.h"
-
-static struct lrcu_handler *__lrcu_handler = NULL;
-LRCU_TLS_DEFINE(struct lrcu_thread_info *, __lrcu_thread_info);
-
-/***********************************************************/
-
-void lrcu_write_barrier_ns(u8 ns_id){
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    struct lrcu_namespace *ns;
-
-    LRCU_ASSERT(h);
-
-    ns = h->ns[ns_id];
-    LRCU_ASSERT(ns);
-
-    ns->version++; /* new ptr's should be seen only with new version */
-}
-LRCU_EXPORT_SYMBOL(lrcu_write_barrier_ns);
-
-/***********************************************************/
-
-void lrcu_write_lock_ns(u8 ns_id){
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    struct lrcu_namespace *ns;
-
-    LRCU_ASSERT(h);
-
-    ns = h->ns[ns_id];
-    LRCU_ASSERT(ns);
-
-    lrcu_spin_lock(&ns->write_lock);
-    ns->version++;
-    wmb();
-}
-LRCU_EXPORT_SYMBOL(lrcu_write_lock_ns);
-
-/***********************************************************/
-
-void lrcu_write_unlock_ns(u8 ns_id){
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    struct lrcu_namespace *ns;
-
-    LRCU_ASSERT(h);
-
-    ns = h->ns[ns_id];
-    LRCU_ASSERT(ns);
-
-    //wmb();
-    //ns->version++;
-    lrcu_spin_unlock(&ns->write_lock);
-}
-LRCU_EXPORT_SYMBOL(lrcu_write_unlock_ns);
-
-
-/***********************************************************/
-
-/* 
-    corener case 3 possible here??????:
-    multiple assign_pointers on to the same pointers,
-    and read section with dereference_pointers
-
-    ....
-    *pp = oldptr, v = 1
-    ...some other lock()
-                            read_lock(v = 1)
-    ns->version++(v = 2)
-                            dereference_ptr(pp = oldptr, v = 2)
-    *pp = newptr
-    free(oldptr)
-    ns->version++(v = 3)
-                            do_work(oldptr)
-
-*/
-void __lrcu_assign_pointer_ns(u8 ns_id, void **pp, void *newptr){
-    lrcu_write_barrier_ns(ns_id);
-    wmb();
-    *pp = newptr;
-}
-LRCU_EXPORT_SYMBOL(__lrcu_assign_pointer_ns);
-
-void lrcu_assign_ptr(struct lrcu_ptr *ptr, void *newptr){
-    lrcu_write_barrier_ns(ptr->ns_id);
-    wmb();
-    ptr->ptr = newptr;
-}
-LRCU_EXPORT_SYMBOL(lrcu_assign_ptr);
-
-void __lrcu_assign_ptr(struct lrcu_ptr *ptr, void *newptr){
-    ptr->ptr = newptr;
-}
-LRCU_EXPORT_SYMBOL(__lrcu_assign_ptr);
-
-/***********************************************************/
-
-void lrcu_read_lock_ns(u8 ns_id){
-    struct lrcu_thread_info *ti = LRCU_GET_TI();
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    lrcu_local_namespace_t * lns;
-    struct lrcu_namespace *ns;
-
-    LRCU_ASSERT(h);
-
-    ns = h->ns[ns_id];
-    LRCU_ASSERT(ns);
-
-    LRCU_ASSERT(ti);
-    lns = LRCU_GET_LNS_ID(ti, ns_id);
-
-    lns->counter++; /* can be nested! */
-    barrier(); /* make sure counter changed first, and only after 
-                            that version. see worker thread read order */
-    /* only first entrance in read section matters */
-    if(likely(lns->counter == 1)){
-        lns->version = ns->version;
-        /* say we entered read section with this ns version */
-        /* barrier for worker thread to see new version */
-        wmb();
-    }
-}
-LRCU_EXPORT_SYMBOL(lrcu_read_lock_ns);
-
-/***********************************************************/
-
-void lrcu_read_unlock_ns(u8 ns_id){
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    struct lrcu_thread_info *ti = LRCU_GET_TI();
-    struct lrcu_namespace *ns;
-    lrcu_local_namespace_t * lns;
-
-    LRCU_ASSERT(h);
-
-    ns = h->ns[ns_id];
-    LRCU_ASSERT(ns);
-
-    LRCU_ASSERT(ti);
-    lns = LRCU_GET_LNS_ID(ti, ns_id);
-
-    if(lns->counter != 1){
-        lns->counter--;
-    }else{
-        /* between protected data access and actual destruction of the object */
-        barrier();
-        lns->counter--;
-        if(lns->version != ns->version){
-            /* 
-            XXX notify thread that called synchronize() that we are done.
-            In current implementation I see this can be omitted since 
-            we can use lazy checks in synchronize(), but if not, might wanna use 
-            per-ns/per-thread pthread condition variable
-            */
-        }
-        barrier();
-    }
-    LRCU_ASSERT(lns->counter >= 0);
-}
-LRCU_EXPORT_SYMBOL(lrcu_read_unlock_ns);
-
-/***********************************************************/
-
-void *__lrcu_dereference(void **ptr){
-    void *p = ACCESS_ONCE(*ptr);
-
-    read_barrier_depends();
-    return p;
-}
-LRCU_EXPORT_SYMBOL(__lrcu_dereference);
-
-void *lrcu_dereference_ptr(struct lrcu_ptr *ptr){
-    void *p = ACCESS_ONCE(ptr->ptr);
-
-    read_barrier_depends();
-    return p;
-}
-LRCU_EXPORT_SYMBOL(lrcu_dereference_ptr);
-
-/***********************************************************/
-
-void lrcu_call_ns(u8 ns_id, void *p, lrcu_destructor_t *destr){
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    struct lrcu_namespace *ns;
-    struct lrcu_ptr local_ptr = {
-        .deinit = destr,
-        .ptr = p,
-    };
-
-    LRCU_ASSERT(h);
-
-    ns = h->ns[ns_id];
-    LRCU_ASSERT(ns);
-
-    local_ptr.version = ns->version, /* synchronize() will be called on this version */
-
-    /* since we don't have local_irq_save(), this_cpu_ptr()
-                        functions, only option is spinlock */
-#ifdef LRCU_LIST_ATOMIC
-    lrcu_list_add_atomic(&ns->free_list, local_ptr);
-#else
-    lrcu_spin_lock(&ns->list_lock);
-
-                            /* NOT A POINTER!!! */
-    lrcu_list_add(&ns->free_list, local_ptr);
-    lrcu_spin_unlock(&ns->list_lock);
-#endif
-    /* XXX wakeup thread. see lrcu_read_unlock */
-}
-LRCU_EXPORT_SYMBOL(lrcu_call_ns);
-
-/***********************************************************/
-
-void lrcu_call_head_ns(u8 ns_id, struct lrcu_ptr_head *head,
-                                    lrcu_destructor_t *destr){
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    struct lrcu_namespace *ns;
-
-    LRCU_ASSERT(h);
-
-    ns = h->ns[ns_id];
-    LRCU_ASSERT(ns);
-
-    head->func = destr;
-    head->ns_id = ns_id;
-    head->version = ns->version;
-
-#ifdef LRCU_LIST_ATOMIC
-    lrcu_list_insert_atomic(&ns->free_hlist, &head->list);
-#else
-    lrcu_spin_lock(&ns->list_hlock);
-    lrcu_list_insert(&ns->free_hlist, &head->list);
-    lrcu_spin_unlock(&ns->list_hlock);
-#endif
-}
-LRCU_EXPORT_SYMBOL(lrcu_call_head_ns);
-
-/***********************************************************/
-
-/*
-Corner cases.
-sequence 1:
-    write_lock(v = 1)
-    assign_ptr
-    lrcu_call(p, v = 1)
-                            read_lock(v = 1) 
-                            deref_ptr(p)                         <---- this cannot happen in correct code(barriers etc.)
-                                                worker_thread(p) <---- we here
-    write_unlock
-                            ...
-                            read_unlock
-**************************************************************
-sequence 2:
-    write_lock(v = 1)
-                            read_lock(v = 1)
-                            deref_ptr(p)
-    assign_ptr
-    lrcu_call(p, v = 1)
-                                                worker_thread(p, v = 1) <---- we here. 
-                                                                        1 == 1 => we cannot free it
-                                                                        we should wait until counter == 0
-    write_unlock
-                            ...
-                            read_unlock
-*/
-static inline void __lrcu_get_synchronized(struct lrcu_namespace *ns, lrcu_rangetree_t *rbt){
-    struct lrcu_thread_info *ti;
-    lrcu_list_t *e, *e_prev;
-    u64 current_version;
-
-    current_version = ns->version;
-    
-    lrcu_spin_lock(&ns->threads_lock);
-
-    /* calculate thread's minimum version */
-    lrcu_list_for_each_ptr(ti, e, e_prev, &ns->threads){
-        LRCU_TIMER_TYPE *ti_timeval = &ti->timeval[ns->id];
-        struct lrcu_local_namespace lns;
-        struct lrcu_local_namespace hung_lns;
-
-        lns = *LRCU_GET_LNS(ti, ns);
-        hung_lns = *LRCU_GET_HUNG_LNS(ti, ns);
-        /* read lns. both counter and version */
-        barrier();
-        /*
-            Calculate thread's safe release version.
-            init. lns.version = 0, counter = 0
-            thread1 enters and leaves write section, ns->version = 1
-            thread2 enters and leaves write section, ns->version = 2, lrcu_call ptr, version = 2
-            thread3 enters read section, counter = 1, version = 2
-            worker wakes up, reads thread's lns, version = 2, counter = 1,
-                            init timeval = now, set hung_lns.version = 2, counter = 1,
-            worker wakes up, reads thread's lns, version = 2, counter = 1,
-                            reads timeval, checks timeout criteria, not timed out
-                            check hung_lns.version against lns.version, if less,
-                            thread woke up after last read section, and entered it again,
-                            with another ns version, if more or equal, thread either woke up and 
-                            entered read section with same verison, or never left previous
-                            so hung_lns.version == lns.version, therefore same version,
-                            add [hung_lns.version, current_version] to rbt,
-                            cannot free ptr with version = 2
-            worker wakes up, reads thread's lns, version = 2, counter = 1,
-                            reads timeval, checks timeout criteria, timed out,
-                            so hung_lns.version == lns.version,
-                            add [hung_lns.version, current_version] to rbt,
-                            moved thread to hung_threads list
-                            set hung_lns.version to current_version
-                            cannot free ptr with version = 2
-... 10 timutes pased
-            worker wakes up, reads thread's lns, version = 2, counter = 1,
-                            usual threads list all empty, checking hung_threads list
-                            counter = 1 and hung_lns.version == lns.version, still hanging,
-                            add [lns.version, hung_lns.version] to rbt,
-                            cannot free ptr with version = 2
-            thread2 enters and leaves write section, ns->version = 3, lrcu_call ptr, version = 3
-            worker wakes up, reads thread's lns, version = 2, counter = 1,
-                            usual threads list all empty, checking hung_threads list
-                            counter = 1 and hung_lns.version == lns.version, still hanging,
-                            add [lns.version, hung_lns.version] to rbt,
-                            cannot free ptr with version = 2
-                            can free ptr with version = 3
-            thread3 leaves read section, counter = 0, version = 2
-... thread 3 keeps working with more recent data, but does not considered as such,
-    thus data gets freed, so incorrect behaviour.
-            thread3 enters read section, counter = 1, version = 3
-            worker wakes up, reads thread's lns, version = 3, counter = 1,
-                            usual threads list all empty, checking hung_threads list
-                            counter = 1 and hung_lns.version < lns.version, 
-                            something happened, data moved forward, 
-                            remove thread from hung_threads list to usual one
-                            add [lns.version, current_version] to rbt,
-                            can free ptr with version = 2
-            worker wakes up, reads thread's lns, version = 2, counter = 0,
-                            nothing to add to lrcu_rangetree
-        */
-        if(lns.counter != 0){
-            lrcu_rangetree_add(rbt, lns.version, current_version);
-            /* 
-                Handling hung thread case.
-                We use hung_lns in usual threads to identify hung threads
-                                in hung threads to identify unfeasable version range for thread
-             */
-            /* we will know that hung thread unhang if we past current_version */
-
-            if(likely(LRCU_TIMER_ISSET(ti_timeval))){ /* hanging timer initialized */
-                /* we are the only ones who has access to hung lns */
-                if(lns.version <= hung_lns.version){
-                    const LRCU_TIMER_TYPE timeout =
-                                LRCU_TIMER_INIT(LRCU_HANG_TIMEOUT_S, 0);
-                    LRCU_TIMER_TYPE timer_expires;
-                    LRCU_TIMER_TYPE now;
-
-                    LRCU_TIMER_ADD(ti_timeval, &timeout, &timer_expires);
-                    LRCU_TIMER_GET(&now);
-                    if(unlikely(!LRCU_TIMER_CMP(&now, &timer_expires, <))){ /* !< is >= */
-                        /* timer expired. thread sleeps too long in read-section 
-                            put thread in list of hanging threads and check them separately */
-
-                        LRCU_WARN("hung thread");
-                        lrcu_list_unlink_next(&ns->threads, e_prev);
-                        lrcu_list_insert(&ns->hung_threads, e);
-                        //LRCU_TIMER_CLEAR(&LRCU_GET_LNS(ti, ns)->timeval);
-                    }
-                }
-            }else{
-                LRCU_TIMER_GET(ti_timeval);
-            }
-            lns.version = current_version; /* record version in which we hang */
-            *LRCU_GET_HUNG_LNS(ti, ns) = lns;
-        }else{ /* counter == 0 */
-            /* corner case 2: we have current version + 1 */
-            LRCU_TIMER_CLEAR(ti_timeval); /* reset hanging thread timer */
-        }
-    }
-
-    /* the point of hang thread, that it has hang version, and  */
-    lrcu_list_for_each_ptr(ti, e, e_prev, &ns->hung_threads){
-        struct lrcu_local_namespace lns, hung_lns;
-
-        hung_lns = *LRCU_GET_HUNG_LNS(ti, ns);
-        lns = *LRCU_GET_LNS(ti, ns);
-        /* read lns and hung_lns */
-        barrier();
-        if(lns.version > hung_lns.version || lns.counter == 0){
-            /* we have been changed after we hung */
-            lrcu_list_unlink_next(&ns->hung_threads, e_prev);
-            lrcu_list_insert(&ns->threads, e);
-        }
-
-        if(lns.counter != 0){
-            if(lns.version > hung_lns.version)
-                lrcu_rangetree_add(rbt, lns.version, current_version);
-            else
-                lrcu_rangetree_add(rbt, lns.version, hung_lns.version);
-        }
-
-        /* 
-            unfeasable version range is [lns->version, hung_lns->version]
-            we can use max version only if all other (usual)threads have 
-            either zero counter, or have known hang point(version)
-        */
-    }
-    lrcu_spin_unlock(&ns->threads_lock);
-    lrcu_rangetree_optimize(rbt, RANGE_BINTREE_OPTLEVEL_MERGE);
-}
-
-static bool lrcu_ns_destructor(struct lrcu_namespace *ns, bool forced){
-    struct lrcu_thread_info *ti;
-    lrcu_list_t *e, *e_prev;
-
-    lrcu_spin_lock(&ns->threads_lock);
-    lrcu_list_for_each_ptr(ti, e, e_prev, &ns->threads){
-        if(forced || (ti->lns[ns->id].counter == 0 &&
-                    ti->lns[ns->id].version >= ns->version)){
-            lrcu_list_unlink_next(&ns->threads, e_prev);
-            LRCU_FREE(e);
-        }
-    }
-    if(lrcu_list_empty(&ns->threads)){
-        lrcu_spin_unlock(&ns->threads_lock);
-        LRCU_FREE(ns);
-        return true;
-    }
-    lrcu_spin_unlock(&ns->threads_lock);
-    return false;
-}
-
-static inline void *lrcu_worker(void *arg){
-    struct lrcu_handler *h = (struct lrcu_handler *)arg;
-    lrcu_range_t ranges[LRCU_THREADS_MAX];
-
-    /*
-        pointer to ti, so that any ns when added threads, 
-        added this one too. this allows to use any ns in destructors
-    */
-    h->worker_ti = __lrcu_thread_init();
-    LRCU_ASSERT(h->worker_ti);
-
-    h->worker_state = LRCU_WORKER_RUNNING;
-    /* let initializing thread see that we changed state */
-    wmb();
-
-    while(h->worker_state != LRCU_WORKER_STOP && !LRCU_THREAD_SHOULD_STOP()){
-        size_t i;
-
-        for(i = 0; i < LRCU_NS_MAX; i++){
-            struct lrcu_namespace *ns = h->worker_ns[i];
-            if(ns == NULL)
-                continue;
-
-            if(!lrcu_list_empty(&ns->free_list)){
-
-#ifdef LRCU_LIST_ATOMIC
-                lrcu_list_splice_atomic(&ns->worker_list, &ns->free_list);
-#else
-                lrcu_spin_lock(&ns->list_lock);
-                lrcu_list_splice(&ns->worker_list, &ns->free_list);
-                lrcu_spin_unlock(&ns->list_lock);
-#endif
-            }
-            if(!lrcu_list_empty(&ns->free_hlist)){
-                //LRCU_LOG("free_hlist not empty\n");
-
-#ifdef LRCU_LIST_ATOMIC
-                lrcu_list_splice_atomic(&ns->worker_hlist, &ns->free_hlist);
-#else
-                lrcu_spin_lock(&ns->list_hlock);
-                lrcu_list_splice(&ns->worker_hlist, &ns->free_hlist);
-                lrcu_spin_unlock(&ns->list_hlock);
-#endif
-            }
-            if(!lrcu_list_empty(&ns->worker_list) ||
-                        !lrcu_list_empty(&ns->worker_hlist)){
-                struct lrcu_ptr *ptr;
-                lrcu_list_t *n, *n_prev;
-                lrcu_rangetree_t rbt = RANGE_BINTREE_INIT(ranges, LRCU_THREADS_MAX);
-                //LRCU_LOG("worker not empty\n");
-
-                __lrcu_get_synchronized(ns, &rbt);
-
-                lrcu_list_for_each(n, n_prev, &ns->worker_list){
-                    ptr = (struct lrcu_ptr *)n->data;
-                    /* do actual job */
-                    if(!lrcu_rangetree_find(&rbt, ptr->version)){
-                        ptr->deinit(ptr->ptr); /* XXX we could reschedule if we are not ready */
-                        lrcu_list_unlink_next(&ns->worker_list, n_prev);
-                        LRCU_FREE(n);
-                    }
-                }
-////////////////TODO
-                lrcu_list_for_each(n, n_prev, &ns->worker_hlist){
-                    struct lrcu_ptr_head *h = container_of(n, struct lrcu_ptr_head, list);
-                    /* do actual job */
-                    //LRCU_LOG("for each worker_hlist %"PRIu64"\n", h->version);
-                    if(!lrcu_rangetree_find(&rbt, h->version)){
-                        lrcu_list_unlink_next(&ns->worker_hlist, n_prev);
-                        h->func(h);
-                    }
-                }
-                /* barrier for processed version write */
-                wmb();
-                /* every callback up to min_version has been called. release lrcu_barrier */
-                ns->processed_version = lrcu_rangetree_getmin(&rbt);
-                if(ns->processed_version == 0)
-                    ns->processed_version = ns->version + 1;
-            }
-            /* make sure we see both ns[] and worker_ns[] */
-            rmb();
-            /*  h->worker_ns[i] and h->ns[i] could be different values,
-                that means ns is freed. our action is to wait for all threads
-                either to suspend, or enter and leave lrcu_read section, so
-                that we definately know that thread does not have released ns
-                The main problem is when thread dereferences h->ns[i],
-                he could be rescheduled for undetermined amount of time,
-                meanwhile ns destructor could be called, but when that thread
-                wakes up, it would access freed memory. This means, that any
-                thread could not be trusted to not have pointer to freeing ns,
-                until it reaches some state, that would indicate 100% it passing
-                that section of code, e.g. (thread_info->lns[i].version >= ns->version)
-            */
-            if(unlikely(lrcu_list_empty(&ns->worker_list)
-                                && lrcu_list_empty(&ns->worker_hlist)
-                                && h->worker_ns[i] != h->ns[i])){
-                lrcu_spin_lock(&h->ns_lock);
-                /* check again under spinlock */
-                if(likely(h->worker_ns[i] != h->ns[i]
-                        && lrcu_list_empty(&ns->free_list)
-                        && lrcu_list_empty(&ns->free_hlist)
-                        && lrcu_ns_destructor(h->worker_ns[i], false))){
-                    h->worker_ns[i] = NULL;
-                    lrcu_spin_unlock(&h->ns_lock);
-                    continue;
-                }
-                lrcu_spin_unlock(&h->ns_lock);
-            }
-
-            lrcu_write_barrier_ns(i); /* bump version so that threads do not hang */
-            if(lrcu_list_empty(&ns->worker_list) &&
-                        lrcu_list_empty(&ns->worker_hlist))
-                ns->processed_version = ns->version;
-        }
-        LRCU_USLEEP(h->worker_timeout);
-    }
-    lrcu_thread_deinit();
-    h->worker_state = LRCU_WORKER_DONE;
-    return NULL;
-}
-
-/***********************************************************/
-
-void lrcu_synchronize_ns(u8 ns_id){
-    struct lrcu_thread_info *ti = LRCU_GET_TI();
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    struct lrcu_namespace *ns;
-    lrcu_range_t ranges[LRCU_THREADS_MAX];
-    u64 current_version;
-
-    if(ti && LRCU_GET_LNS_ID(ti, ns_id))
-        LRCU_ASSERT(LRCU_GET_LNS_ID(ti, ns_id)->counter == 0);
-
-    LRCU_ASSERT(h);
-
-    ns = h->ns[ns_id];
-    LRCU_ASSERT(ns);
-
-    current_version = ns->version;
-    rmb();
-    /* XXX not infinite loop */
-    while(1){
-        lrcu_rangetree_t rbt = RANGE_BINTREE_INIT(ranges, LRCU_THREADS_MAX);
-
-        __lrcu_get_synchronized(ns, &rbt);
-
-        if(!lrcu_rangetree_find(&rbt, current_version))
-            break;
-        LRCU_USLEEP(ns->sync_timeout);
-    }
-}
-LRCU_EXPORT_SYMBOL(lrcu_synchronize_ns);
-
-/***********************************************************/
-
-void lrcu_barrier_ns(u8 ns_id){
-    struct lrcu_thread_info *ti = LRCU_GET_TI();
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    struct lrcu_namespace *ns;
-    u64 current_version;
-
-    lrcu_synchronize_ns(ns_id);
-
-    if(ti && LRCU_GET_LNS_ID(ti, ns_id))
-        LRCU_ASSERT(LRCU_GET_LNS_ID(ti, ns_id)->counter == 0);
-
-    LRCU_ASSERT(h);
-
-    ns = h->ns[ns_id];
-    LRCU_ASSERT(ns);
-
-    current_version = ns->version;
-    /* XXX not infinite loop */
-    while(1){
-        /* barrier for processed version read */
-        rmb();
-        if(current_version < ns->processed_version)
-            break;
-        LRCU_USLEEP(ns->sync_timeout);
-    }
-}
-LRCU_EXPORT_SYMBOL(lrcu_barrier_ns);
-
-/***********************************************************/
-
-/* TODO make it constructor/destructor */
-struct lrcu_handler *lrcu_init(void){
-    struct lrcu_handler *h = __lrcu_init();
-
-    LRCU_ASSERT(h);
-    if(lrcu_ns_init(LRCU_NS_DEFAULT))
-        return h;
-
-    /* failed */
-    lrcu_deinit();
-    return NULL;
-}
-LRCU_EXPORT_SYMBOL(lrcu_init);
-
-struct lrcu_handler *__lrcu_init(void){
-    struct lrcu_handler *h;
-
-    LRCU_TLS_INIT(__lrcu_thread_info);
-
-    h = LRCU_CALLOC(1, sizeof(struct lrcu_handler));
-    if(h == NULL)
-        return NULL;
-
-    h->worker_state = LRCU_WORKER_RUN;
-    /* protect worker_state reads and writes here and in worker */
-    mb();
-
-    h->worker_timeout = LRCU_WORKER_SLEEP_US;
-    LRCU_SET_HANDLER(h);
-
-    if(LRCU_THREAD_CREATE(&h->worker_tid, lrcu_worker, (void *)h))
-        goto out;
-
-    barrier();
-    /* wait for worker thread to start */
-    while(h->worker_state == LRCU_WORKER_RUN)
-        LRCU_USLEEP(1);
-
-    /* worker_state */
-    mb();
-
-    if(h->worker_state != LRCU_WORKER_RUNNING)
-        goto out;
-
-    return h;
-out:
-    LRCU_DEL_HANDLER();
-    LRCU_FREE(h);
-    LRCU_TLS_DEINIT(__lrcu_thread_info);
-    return NULL;
-}
-LRCU_EXPORT_SYMBOL(__lrcu_init);
-
-void lrcu_deinit(void){
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-
-    LRCU_ASSERT(h);
-
-    /* unsafe */
-    //lrcu_ns_deinit(LRCU_NS_DEFAULT); TODO
-
-    h->worker_state = LRCU_WORKER_STOP;
-
-    LRCU_THREAD_JOIN(&h->worker_tid);
-    LRCU_DEL_HANDLER();
-
-    LRCU_TLS_DEINIT(__lrcu_thread_info);
-    /* TODO remove all ns and do something with all ptrs? */
-}
-LRCU_EXPORT_SYMBOL(lrcu_deinit);
-
-/***********************************************************/
-
-struct lrcu_namespace *lrcu_ns_init(u8 id){
-    struct lrcu_namespace *ns = NULL;
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-
-    LRCU_ASSERT(h);
-
-    /* schedule lrcu_thread_set_ns to worker */
-
-    lrcu_spin_lock(&h->ns_lock);
-    LRCU_ASSERT(!h->ns[id]);
-    LRCU_ASSERT(h->worker_ti);
-
-    if(h->worker_ns[id] != NULL){
-        lrcu_list_t *e;
-        /* alraedy allocated, but pending removal. nothing to do */
-        ns = h->worker_ns[id];
-        e = lrcu_list_find_ptr(&ns->threads, h->worker_ti);
-        LRCU_ASSERT(e);
-        /* how can this be? when removing, we should take lock */
-        if(e == NULL){
-            /* no need to take threads_lock since we are not working ns */
-            if (lrcu_list_add(&ns->threads, h->worker_ti) == NULL){
-                lrcu_spin_unlock(&h->ns_lock);
-                return NULL;
-            }
-        }
-        /* make sure we add first, only then recreate ns. XXX maybe wmb()? */
-        barrier();
-        h->ns[id] = ns;
-        lrcu_spin_unlock(&h->ns_lock);
-        return ns;
-    }
-
-    ns = LRCU_CALLOC(1, sizeof(struct lrcu_namespace));
-    if(ns == NULL)
-        goto out;
-
-    ns->id = id;
-    ns->version = 1;
-    ns->sync_timeout = LRCU_NS_SYNC_SLEEP_US;
-    /* no need to take a lock */
-    if (lrcu_list_add(&ns->threads, h->worker_ti) == NULL){
-        LRCU_FREE(ns);
-        ns = NULL;
-        goto out;
-    }
-    /* first allocate and init, then assign */
-    wmb();
-    h->ns[id] = ns;
-    h->worker_ns[id] = ns;
-    wmb(); /* make sure they are seen both. have rmb() on read side */
-
-out:
-    lrcu_spin_unlock(&h->ns_lock);
-    return ns;
-}
-LRCU_EXPORT_SYMBOL(lrcu_ns_init);
-
-void lrcu_ns_deinit_safe(u8 id){
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    struct lrcu_namespace *ns;
-    
-    LRCU_ASSERT(h);
-
-    lrcu_spin_lock(&h->ns_lock);
-    ns = h->ns[id];
-    LRCU_ASSERT(ns);
-
-    h->ns[id] = NULL;
-    /* all threads shall see this pointer now */
-    wmb();
-    lrcu_write_barrier_ns(id); /* bump version */
-    lrcu_spin_unlock(&h->ns_lock);
-}
-LRCU_EXPORT_SYMBOL(lrcu_ns_deinit_safe);
-
-void lrcu_ns_deinit(u8 id){
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    struct lrcu_namespace *ns;
-
-    LRCU_ASSERT(h);
-
-    lrcu_spin_lock(&h->ns_lock);
-    ns = h->ns[id];
-    LRCU_ASSERT(ns);
-
-    h->ns[id] = NULL;
-    /* all threads shall see this pointer now */
-    wmb();
-
-    lrcu_write_barrier_ns(id); /* bump version */
-    lrcu_barrier_ns(id); /* wait for all callbacks to execute */
-    lrcu_ns_destructor(h->worker_ns[id], true);
-    barrier();
-    h->worker_ns[id] = NULL;
-
-    lrcu_spin_unlock(&h->ns_lock);
-}
-LRCU_EXPORT_SYMBOL(lrcu_ns_deinit);
-
-struct lrcu_thread_info *lrcu_thread_init(void){
-    struct lrcu_thread_info *ti = __lrcu_thread_init();
-
-    LRCU_ASSERT(ti);
-
-    if(!lrcu_thread_set_ns(LRCU_NS_DEFAULT)){
-        lrcu_thread_deinit();
-        return NULL;
-    }
-
-    return ti;
-}
-LRCU_EXPORT_SYMBOL(lrcu_thread_init);
-
-struct lrcu_thread_info *__lrcu_thread_init(void){
-    struct lrcu_thread_info *ti = NULL;
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-
-    LRCU_ASSERT(h);
-
-    ti = LRCU_CALLOC(1, sizeof(struct lrcu_thread_info));
-    if(ti == NULL)
-        return NULL;
-
-    ti->h = h;
-    LRCU_SET_TI(ti);
-
-    return ti;
-}
-LRCU_EXPORT_SYMBOL(__lrcu_thread_init);
-
-bool lrcu_thread_set_ns(u8 ns_id){
-    struct lrcu_thread_info *ti = LRCU_GET_TI();
-    struct lrcu_handler *h = LRCU_GET_HANDLER();
-    struct lrcu_namespace *ns;
-    void *ret;
-
-    LRCU_ASSERT(h);
-    LRCU_ASSERT(ti);
-
-    lrcu_spin_lock(&h->ns_lock);
-    ns = h->ns[ns_id];
-    LRCU_ASSERT(ns);
-    lrcu_spin_unlock(&h->ns_lock);
-
-    /* locking in spinlock. careful of deadlock */
-    lrcu_spin_lock(&ns->threads_lock);
-    ret = lrcu_list_add(&ns->threads, ti);
-    lrcu_spin_unlock(&ns->threads_lock);
-
-    return ret != NULL;
-}
-LRCU_EXPORT_SYMBOL(lrcu_thread_set_ns);
-
-/* assume ns lock taken and ti and ti->h non-null */
-static bool thread_remove_from_ns(struct lrcu_thread_info *ti, u8 ns_id){
-    struct lrcu_namespace *ns = ti->h->worker_ns[ns_id];
-    lrcu_list_t *e;
-    int found = false;
-
-    LRCU_ASSERT(ns);
-
-    lrcu_spin_lock(&ns->threads_lock); /* locking in spinlock. careful of deadlock */
-    e = lrcu_list_find_ptr_unlink(&ns->threads, ti);
-    if(e){
-        found = true;
-        LRCU_FREE(e);
-    }
-    lrcu_spin_unlock(&ns->threads_lock);
-    if(!found){
-        /* failed to set thread's ns, then exited thread. */
-    }
-    return found;
-}
-
-bool lrcu_thread_del_ns(u8 ns_id){
-    struct lrcu_thread_info *ti = LRCU_GET_TI();
-    bool ret;
-
-    LRCU_ASSERT(ti);
-    LRCU_ASSERT(ti->h);
-
-    lrcu_spin_lock(&ti->h->ns_lock);
-    ret = thread_remove_from_ns(ti, ns_id);
-    lrcu_spin_unlock(&ti->h->ns_lock);
-
-    return ret;
-}
-LRCU_EXPORT_SYMBOL(lrcu_thread_del_ns);
-
-static void thread_destructor_callback(struct lrcu_thread_info *ti){
-    struct lrcu_handler *h = ti->h;
-    int found = false;
-    int i;
-
-    LRCU_ASSERT(ti);
-    LRCU_ASSERT(h);
-
-    lrcu_spin_lock(&h->ns_lock);
-    for(i = 0; i < LRCU_NS_MAX; i++){
-        found = found || thread_remove_from_ns(ti, i);
-    }
-    lrcu_spin_unlock(&h->ns_lock);
-    if(!found){
-        /* failed to set thread's ns, then exited thread. */
-    }
-    LRCU_FREE(ti);
-}
-
-#if 0
-void lrcu_thread_deinit(void){
-    struct lrcu_thread_info *ti = LRCU_GET_TI();
-    if(ti == NULL)
-        return;
-
-    /* remove from all namespaces */
-    __lrcu_call_ns(LRCU_NS_DEFAULT, (void *)ti, (lrcu_destructor_t *)thread_destructor_callback);
-    LRCU_DEL_TI(ti);
-    /* wait for it to process, since TLS gets deleted with the thread */
-    lrcu_barrier_ns(LRCU_NS_DEFAULT);
-}
-#endif
-
-void lrcu_thread_deinit(void){
-    struct lrcu_thread_info *ti = LRCU_GET_TI();
-
-    LRCU_ASSERT(ti);
-
-    if(ti)
-        thread_destructor_callback(ti);
-    LRCU_DEL_TI(ti);
-}
-LRCU_EXPORT_SYMBOL(lrcu_thread_deinit);
-
-/* already allocated ptr */
-void lrcu_ptr_init(struct lrcu_ptr *ptr, u8 ns_id, 
-                                lrcu_destructor_t *deinit){
-    ptr->ns_id = ns_id;
-    ptr->deinit = deinit;
-    ptr->ptr = NULL;
-}
-LRCU_EXPORT_SYMBOL(lrcu_ptr_init);
-
-/* getters for private fields */
-struct lrcu_namespace *lrcu_ti_get_ns(struct lrcu_thread_info *ti, u8 id){
-    LRCU_ASSERT(ti);
-    LRCU_ASSERT(ti->h);
-    return ti->h->ns[id];
-}
-
-struct lrcu_namespace *lrcu_get_ns(struct lrcu_handler *h, u8 id){
-    LRCU_ASSERT(h);
-    return h->ns[id];
-}
-
-LRCU_OS_API_DEFINE
+/*
+    Lazy RCU: extra light read section and hard write section
+    locks taken only on lrcu_ptr  
+*/
+
+#include <lrcu/lrcu.h>
+#include "lrcu_internal.h"
+#include "range.h"
+
+static struct lrcu_handler *__lrcu_handler = NULL;
+LRCU_TLS_DEFINE(struct lrcu_thread_info *, __lrcu_thread_info);
+#ifdef LRCU_READ_INLINE
+LRCU_TLS_DEFINE_EXPORTED(struct lrcu_read_cache, __lrcu_read_cache[LRCU_NS_MAX]);
+/* bumped when namespace is freed, see lrcu_read_cache_valid */
+u32 __lrcu_ns_gen[LRCU_NS_MAX];
+/* LRCU_FLAVOR_PERCPU nesting for threads without thread_info */
+LRCU_TLS_DEFINE(struct lrcu_local_namespace, __lrcu_percpu_lns[LRCU_NS_MAX]);
+#endif
+
+/* version field keeps epoch of outermost read_lock */
+static inline lrcu_local_namespace_t *lrcu_percpu_lns(
+                            struct lrcu_thread_info *ti, u8 ns_id){
+#ifdef LRCU_READ_INLINE
+    (void)ti;
+    return &LRCU_TLS_GET(__lrcu_percpu_lns)[ns_id];
+#else
+    LRCU_ASSERT(ti);
+    return LRCU_GET_LNS_ID(ti, ns_id);
+#endif
+}
+
+/* thread's leaf flag in ns, NULL if it is not registered there */
+static inline u32 *lrcu_ti_dirty(struct lrcu_thread_info *ti, u8 ns_id){
+    if(ti == NULL || ti->leaf[ns_id] == NULL)
+        return NULL;
+    return &ti->leaf[ns_id]->dirty;
+}
+
+static inline void lrcu_read_cache_set(struct lrcu_thread_info *ti,
+                                        struct lrcu_namespace *ns){
+#ifdef LRCU_READ_INLINE
+    struct lrcu_read_cache *rc = &LRCU_TLS_GET(__lrcu_read_cache)[ns->id];
+
+    rc->ns = ns;
+    rc->version = &ns->version;
+    rc->wait = &ns->sync_wait;
+    rc->dirty = lrcu_ti_dirty(ti, ns->id);
+    rc->flavor = ns->flavor;
+    rc->gen = ns->gen;
+    if(LRCU_FLAVOR_IS_PERCPU(ns->flavor))
+        rc->lns = lrcu_percpu_lns(ti, ns->id);
+    else
+        rc->lns = LRCU_GET_LNS(ti, ns);
+#else
+    (void)ti;
+    (void)ns;
+#endif
+}
+
+static inline void lrcu_read_cache_clear(u8 ns_id){
+#ifdef LRCU_READ_INLINE
+    struct lrcu_read_cache *rc = &LRCU_TLS_GET(__lrcu_read_cache)[ns_id];
+
+    rc->lns = NULL;
+    rc->version = NULL;
+    rc->ns = NULL;
+    rc->wait = NULL;
+    rc->dirty = NULL;
+#else
+    (void)ns_id;
+#endif
+}
+
+/* namespace could be freed and allocated again. drop stale pointers */
+static inline void lrcu_read_cache_check(struct lrcu_namespace *ns){
+#ifdef LRCU_READ_INLINE
+    if(unlikely(LRCU_TLS_GET(__lrcu_read_cache)[ns->id].ns != ns))
+        lrcu_read_cache_clear(ns->id);
+#else
+    (void)ns;
+#endif
+}
+
+/***********************************************************/
+
+static void lrcu_thread_info_init(struct lrcu_thread_info *ti,
+                                                struct lrcu_handler *h){
+    size_t i;
+
+    ti->h = h;
+    for(i = 0; i < LRCU_NS_MAX; i++)
+        ti->lns[i] = &ti->own_lns[i];
+}
+
+/* under threads_lock. false if thread is not registered in ns */
+static inline struct lrcu_leaf *lrcu_ns_thread_leaf(struct lrcu_namespace *ns,
+                                        struct lrcu_thread_info *ti){
+    u32 slot = ti->slot[ns->id];
+    struct lrcu_leaf *leaf;
+
+    if(slot == 0 || LRCU_SLOT_LEAF(slot) >= ns->nr_leaves)
+        return NULL;
+    leaf = ns->leaves[LRCU_SLOT_LEAF(slot)];
+    if(leaf->ti[LRCU_SLOT_BIT(slot)] != ti ||
+                !(leaf->used & (1ULL << LRCU_SLOT_BIT(slot))))
+        return NULL;
+    return leaf;
+}
+
+/* under threads_lock. takes first free slot, adds a leaf if none, 0 if no memory */
+static u32 lrcu_ns_slot_take(struct lrcu_namespace *ns){
+    struct lrcu_leaf *leaf;
+    u32 l, bit;
+
+    for(l = 0; l < ns->nr_leaves; l++)
+        if(~ns->leaves[l]->used)
+            break;
+    if(l == ns->nr_leaves){
+        struct lrcu_leaf **leaves;
+        u32 i;
+
+        leaves = LRCU_CALLOC(l + 1, sizeof(struct lrcu_leaf *));
+        if(leaves == NULL)
+            return 0;
+        leaf = LRCU_CALLOC(1, sizeof(struct lrcu_leaf));
+        if(leaf == NULL){
+            LRCU_FREE(leaves);
+            return 0;
+        }
+        for(i = 0; i < l; i++)
+            leaves[i] = ns->leaves[i];
+        leaves[l] = leaf;
+        LRCU_FREE(ns->leaves);
+        ns->leaves = leaves;
+        ns->nr_leaves++;
+    }
+    leaf = ns->leaves[l];
+    bit = __builtin_ctzll(~leaf->used);
+
+    LRCU_TIMER_CLEAR(&leaf->state[bit].timeval);
+    leaf->hung &= ~(1ULL << bit);
+    leaf->used |= 1ULL << bit;
+    ACCESS_ONCE(leaf->dirty) = 1; /* scan it at least once */
+    ns->nr_threads++;
+    return l * LRCU_LEAF_THREADS + bit + 1;
+}
+
+/* under threads_lock */
+static void lrcu_ns_slot_put(struct lrcu_namespace *ns,
+                                        struct lrcu_leaf *leaf, u32 b){
+    leaf->used &= ~(1ULL << b);
+    leaf->hung &= ~(1ULL << b);
+    leaf->ctx &= ~(1ULL << b);
+    leaf->ti[b] = NULL;
+    ns->nr_threads--;
+}
+
+/* under threads_lock */
+static bool lrcu_ns_thread_add(struct lrcu_namespace *ns,
+                                        struct lrcu_thread_info *ti){
+    struct lrcu_leaf *leaf;
+    u32 slot, bit;
+
+    slot = lrcu_ns_slot_take(ns);
+    if(slot == 0)
+        return false;
+    leaf = ns->leaves[LRCU_SLOT_LEAF(slot)];
+    bit = LRCU_SLOT_BIT(slot);
+
+    /* thread's state moves to the slot, e.g. QSBR online counter */
+    leaf->slots[bit].lns = ti->own_lns[ns->id];
+    ti->lns[ns->id] = &leaf->slots[bit].lns;
+    leaf->ti[bit] = ti;
+    ti->slot[ns->id] = slot;
+    ti->leaf[ns->id] = leaf;
+    return true;
+}
+
+static inline void lrcu_call_bounds_add(struct lrcu_call_bounds *b, u64 v){
+    if(b->minv == 0 || v < b->minv)
+        b->minv = v;
+    if(v > b->maxv)
+        b->maxv = v;
+}
+
+/* dst += src, src = none */
+static inline void lrcu_call_bounds_take(struct lrcu_call_bounds *dst,
+                                            struct lrcu_call_bounds *src){
+    if(src->minv == 0)
+        return;
+    lrcu_call_bounds_add(dst, src->minv);
+    lrcu_call_bounds_add(dst, src->maxv);
+    src->minv = src->maxv = 0;
+}
+
+/* leftover callbacks of a leaving thread go to shared lists */
+static void lrcu_call_queue_flush(struct lrcu_namespace *ns,
+                                            struct lrcu_call_queue *q){
+#ifndef LRCU_LIST_ATOMIC
+    struct lrcu_call_bounds hbounds;
+#endif
+
+    lrcu_spin_lock(&q->lock);
+#ifdef LRCU_LIST_ATOMIC
+    while(!lrcu_queue_empty(&q->list)){
+        lrcu_list_t *e = q->list.lh.head;
+
+        q->list.lh.head = e->next;
+        lrcu_list_insert_atomic(&ns->free_list.lh, e);
+    }
+    while(!lrcu_queue_empty(&q->hlist)){
+        lrcu_list_t *e = q->hlist.lh.head;
+
+        q->hlist.lh.head = e->next;
+        lrcu_list_insert_atomic(&ns->free_hlist.lh, e);
+    }
+#else
+    /* bounds cover both lists, so both get them */
+    hbounds = q->bounds;
+    if(!lrcu_queue_empty(&q->list)){
+        lrcu_spin_lock(&ns->list_lock);
+        lrcu_queue_splice(&ns->free_list, &q->list);
+        lrcu_call_bounds_take(&ns->free_bounds, &q->bounds);
+        lrcu_spin_unlock(&ns->list_lock);
+    }
+    if(!lrcu_queue_empty(&q->hlist)){
+        lrcu_spin_lock(&ns->list_hlock);
+        lrcu_queue_splice(&ns->free_hlist, &q->hlist);
+        lrcu_call_bounds_take(&ns->free_hbounds, &hbounds);
+        lrcu_spin_unlock(&ns->list_hlock);
+    }
+#endif
+    q->bounds.minv = q->bounds.maxv = 0;
+    lrcu_spin_unlock(&q->lock);
+}
+
+/* under threads_lock */
+static bool lrcu_ns_thread_del(struct lrcu_namespace *ns,
+                                        struct lrcu_thread_info *ti){
+    struct lrcu_leaf *leaf = lrcu_ns_thread_leaf(ns, ti);
+    u32 b;
+
+    if(leaf == NULL)
+        return false;
+    b = LRCU_SLOT_BIT(ti->slot[ns->id]);
+    lrcu_call_queue_flush(ns, &ti->calls[ns->id]);
+    ti->own_lns[ns->id] = leaf->slots[b].lns;
+    ti->lns[ns->id] = &ti->own_lns[ns->id];
+    lrcu_ns_slot_put(ns, leaf, b);
+    ti->slot[ns->id] = 0;
+    ti->leaf[ns->id] = NULL;
+    return true;
+}
+
+static void lrcu_ns_leaves_free(struct lrcu_namespace *ns){
+    u32 l;
+
+    for(l = 0; l < ns->nr_leaves; l++)
+        LRCU_FREE(ns->leaves[l]);
+    LRCU_FREE(ns->leaves);
+    ns->leaves = NULL;
+    ns->nr_leaves = 0;
+}
+
+/***********************************************************/
+
+/*
+    Worker parks when no namespace has callbacks. Callers publish work
+    (callback in free list) and then look at worker_parked, worker sets
+    worker_parked and then looks for work, so one of them sees the other.
+    kick - worker has to do one more full pass even with no callbacks,
+    e.g. lrcu_barrier waits for processed_version.
+*/
+static inline void lrcu_worker_wake(struct lrcu_handler *h, bool kick){
+    if(kick)
+        lrcu_atomic_inc(&h->worker_wake);
+    mb();
+    if(unlikely(ACCESS_ONCE(h->worker_parked))){
+        if(!kick)
+            lrcu_atomic_inc(&h->worker_wake);
+        LRCU_FUTEX_WAKE(&h->worker_wake);
+    }
+}
+
+/*
+    Waiter sets armed and sleeps on seq. First reader to see it armed
+    takes it, so a crowd of unlocks makes one syscall.
+*/
+void __lrcu_sync_wake(struct lrcu_sync_wait *w){
+    if(lrcu_cmpxchg(&w->armed, 1, 0) == 1){
+        /* woken waiters arm again with their own versions */
+        ACCESS_ONCE(w->version) = 0;
+        lrcu_atomic_inc(&w->seq);
+        LRCU_FUTEX_WAKE(&w->seq);
+    }
+}
+LRCU_EXPORT_SYMBOL(__lrcu_sync_wake);
+
+/* sleep until reader or worker wakes us up, or sync_timeout passes */
+static inline u32 lrcu_sync_wait_arm(struct lrcu_namespace *ns, u64 version){
+    struct lrcu_sync_wait *w = &ns->sync_wait;
+    u32 seq = ACCESS_ONCE(w->seq);
+    u64 old;
+
+    /*
+        Keep the oldest version waited for, its readers are the ones
+        to wake us. Concurrent waiters race here, so cmpxchg.
+        Version 0 - only the worker wakes us, nothing to keep.
+    */
+    while(version){
+        old = ACCESS_ONCE(w->version);
+        if(old && old <= version)
+            break;
+        if(lrcu_cmpxchg(&w->version, old, version) == old)
+            break;
+    }
+    w->armed = 1;
+    mb(); /* armed before we look at readers. see lrcu_sync_wake_check */
+    return seq;
+}
+
+static inline void lrcu_sync_wait_sleep(struct lrcu_namespace *ns, u32 seq){
+    LRCU_FUTEX_WAIT(&ns->sync_wait.seq, seq, ns->sync_timeout);
+}
+
+/***********************************************************/
+
+void lrcu_write_barrier_ns(u8 ns_id){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    /* writers may not share a lock, do not lose increments */
+    lrcu_atomic_inc(&ns->version);
+}
+LRCU_EXPORT_SYMBOL(lrcu_write_barrier_ns);
+
+/*
+    Grace period start. Readers entering after it get a version newer
+    than snapshot. If somebody moved it since snapshot, that is enough,
+    so concurrent callers and the worker bump it once, not each.
+*/
+static inline void lrcu_version_advance(struct lrcu_namespace *ns,
+                                                    u64 snapshot){
+    if(ACCESS_ONCE(ns->version) == snapshot)
+        lrcu_cmpxchg(&ns->version, snapshot, snapshot + 1);
+}
+
+/***********************************************************/
+
+void lrcu_write_lock_ns(u8 ns_id){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    /* version moves on grace period start, not on every writer */
+    lrcu_spin_lock(&ns->write_lock);
+}
+LRCU_EXPORT_SYMBOL(lrcu_write_lock_ns);
+
+/***********************************************************/
+
+void lrcu_write_unlock_ns(u8 ns_id){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    //wmb();
+    //ns->version++;
+    lrcu_spin_unlock(&ns->write_lock);
+}
+LRCU_EXPORT_SYMBOL(lrcu_write_unlock_ns);
+
+
+/***********************************************************/
+
+/* 
+    corener case 3 possible here??????:
+    multiple assign_pointers on to the same pointers,
+    and read section with dereference_pointers
+
+    ....
+    *pp = oldptr, v = 1
+    ...some other lock()
+                            read_lock(v = 1)
+    ns->version++(v = 2)
+                            dereference_ptr(pp = oldptr, v = 2)
+    *pp = newptr
+    free(oldptr)
+    ns->version++(v = 3)
+                            do_work(oldptr)
+
+*/
+void __lrcu_assign_pointer_ns(u8 ns_id, void **pp, void *newptr){
+    (void)ns_id;
+    /* object initialization before publication */
+    wmb();
+    *pp = newptr;
+}
+LRCU_EXPORT_SYMBOL(__lrcu_assign_pointer_ns);
+
+void lrcu_assign_ptr(struct lrcu_ptr *ptr, void *newptr){
+    wmb();
+    ptr->ptr = newptr;
+}
+LRCU_EXPORT_SYMBOL(lrcu_assign_ptr);
+
+void __lrcu_assign_ptr(struct lrcu_ptr *ptr, void *newptr){
+    ptr->ptr = newptr;
+}
+LRCU_EXPORT_SYMBOL(__lrcu_assign_ptr);
+
+void *__lrcu_xchg_pointer(void **pp, void *newptr){
+    return lrcu_xchg(pp, newptr);
+}
+LRCU_EXPORT_SYMBOL(__lrcu_xchg_pointer);
+
+void *__lrcu_cmpxchg_pointer(void **pp, void *oldptr, void *newptr){
+    return lrcu_cmpxchg(pp, oldptr, newptr);
+}
+LRCU_EXPORT_SYMBOL(__lrcu_cmpxchg_pointer);
+
+void *lrcu_xchg_ptr(struct lrcu_ptr *ptr, void *newptr){
+    return lrcu_xchg(&ptr->ptr, newptr);
+}
+LRCU_EXPORT_SYMBOL(lrcu_xchg_ptr);
+
+/***********************************************************/
+
+/*
+    LRCU_FLAVOR_PERCPU. Only outermost section is counted. Thread could
+    migrate inside the section, so unlock is counted on another cpu, but
+    only sums over all cpus matter. Atomic ops are full barriers.
+*/
+static inline int lrcu_percpu_lock_idx(struct lrcu_namespace *ns){
+    u32 cpu = (u32)LRCU_GET_CPU() % ns->nr_cpus;
+    int idx = ACCESS_ONCE(ns->pcpu_idx) & 1;
+
+    lrcu_atomic_inc(&ns->pcpu[cpu].lock[idx]);
+    return idx;
+}
+
+static inline void lrcu_percpu_unlock_idx(struct lrcu_namespace *ns, int idx){
+    u32 cpu = (u32)LRCU_GET_CPU() % ns->nr_cpus;
+
+    lrcu_atomic_inc(&ns->pcpu[cpu].unlock[idx]);
+    /* epochs are not versions, any waiter could be waiting for us */
+    lrcu_sync_wake_check(&ns->sync_wait, 0);
+}
+
+static inline void lrcu_percpu_read_lock(struct lrcu_namespace *ns,
+                                            lrcu_local_namespace_t *lns){
+    if(lns->counter++ == 0)
+        lns->version = lrcu_percpu_lock_idx(ns);
+}
+
+static inline void lrcu_percpu_read_unlock(struct lrcu_namespace *ns,
+                                            lrcu_local_namespace_t *lns){
+    LRCU_ASSERT(lns->counter > 0);
+    if(--lns->counter == 0)
+        lrcu_percpu_unlock_idx(ns, lns->version);
+}
+
+/* cache is filled, skip lookups. thread_info is not needed */
+static inline bool lrcu_percpu_cached(u8 ns_id, bool lock){
+#ifdef LRCU_READ_INLINE
+    struct lrcu_read_cache *rc = &LRCU_TLS_GET(__lrcu_read_cache)[ns_id];
+
+    if(!LRCU_FLAVOR_IS_PERCPU(rc->flavor) || rc->ns == NULL ||
+                                    !lrcu_read_cache_valid(rc, ns_id))
+        return false;
+    if(lock)
+        lrcu_percpu_read_lock(rc->ns, rc->lns);
+    else
+        lrcu_percpu_read_unlock(rc->ns, rc->lns);
+    return true;
+#else
+    (void)ns_id;
+    (void)lock;
+    return false;
+#endif
+}
+
+void __lrcu_read_lock_ns(u8 ns_id){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    lrcu_local_namespace_t * lns;
+    struct lrcu_namespace *ns;
+
+    if(lrcu_percpu_cached(ns_id, true))
+        return;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    if(LRCU_FLAVOR_IS_PERCPU(ns->flavor)){
+        lrcu_read_cache_set(ti, ns);
+        lrcu_percpu_read_lock(ns, lrcu_percpu_lns(ti, ns_id));
+        return;
+    }
+
+    LRCU_ASSERT(ti);
+    lns = LRCU_GET_LNS_ID(ti, ns_id);
+    /* next read_lock goes through inline fast path */
+    lrcu_read_cache_set(ti, ns);
+    if(ns->flavor == LRCU_FLAVOR_QSBR)
+        return;
+
+    lns->counter++; /* can be nested! */
+    barrier(); /* make sure counter changed first, and only after 
+                            that version. see worker thread read order */
+    /* only first entrance in read section matters */
+    if(likely(lns->counter == 1)){
+        lns->version = ns->version;
+        /* say we entered read section with this ns version */
+        /* barrier for worker thread to see new version, then the mark */
+        if(ns->flavor == LRCU_FLAVOR_MEMBARRIER)
+            barrier();
+        else
+            mb();
+        lrcu_leaf_mark_dirty(lrcu_ti_dirty(ti, ns_id), ns->flavor);
+    }
+}
+LRCU_EXPORT_SYMBOL(__lrcu_read_lock_ns);
+
+/***********************************************************/
+
+void __lrcu_read_unlock_ns(u8 ns_id){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_namespace *ns;
+    lrcu_local_namespace_t * lns;
+
+    if(lrcu_percpu_cached(ns_id, false))
+        return;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    if(LRCU_FLAVOR_IS_PERCPU(ns->flavor)){
+        lrcu_percpu_read_unlock(ns, lrcu_percpu_lns(ti, ns_id));
+        return;
+    }
+
+    LRCU_ASSERT(ti);
+    lns = LRCU_GET_LNS_ID(ti, ns_id);
+
+    if(ns->flavor == LRCU_FLAVOR_QSBR)
+        return;
+
+    if(lns->counter != 1){
+        lns->counter--;
+    }else{
+        /* between protected data access and actual destruction of the object */
+        barrier();
+        lns->counter--;
+        barrier();
+        /* notify thread that called synchronize() that we are done */
+        lrcu_sync_wake_check(&ns->sync_wait, lns->version);
+    }
+    LRCU_ASSERT(lns->counter >= 0);
+}
+LRCU_EXPORT_SYMBOL(__lrcu_read_unlock_ns);
+
+/***********************************************************/
+
+/* every section is counted on its own, nesting needs no state */
+int lrcu_read_lock_sleepable_ns(u8 ns_id){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+    LRCU_ASSERT(ns->flavor == LRCU_FLAVOR_SLEEPABLE);
+
+    return lrcu_percpu_lock_idx(ns);
+}
+LRCU_EXPORT_SYMBOL(lrcu_read_lock_sleepable_ns);
+
+void lrcu_read_unlock_sleepable_ns(u8 ns_id, int idx){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+    LRCU_ASSERT(idx == 0 || idx == 1);
+
+    lrcu_percpu_unlock_idx(ns, idx);
+}
+LRCU_EXPORT_SYMBOL(lrcu_read_unlock_sleepable_ns);
+
+/***********************************************************/
+
+/* out-of-line versions. every namespace takes its own slow path */
+void __lrcu_read_lock_set(u64 mask){
+    while(mask){
+        u8 ns_id = __builtin_ctzll(mask);
+
+        mask &= mask - 1;
+        LRCU_ASSERT(ns_id < LRCU_NS_MAX);
+        __lrcu_read_lock_ns(ns_id);
+    }
+}
+LRCU_EXPORT_SYMBOL(__lrcu_read_lock_set);
+
+void __lrcu_read_unlock_set(u64 mask){
+    while(mask){
+        u8 ns_id = __builtin_ctzll(mask);
+
+        mask &= mask - 1;
+        LRCU_ASSERT(ns_id < LRCU_NS_MAX);
+        __lrcu_read_unlock_ns(ns_id);
+    }
+}
+LRCU_EXPORT_SYMBOL(__lrcu_read_unlock_set);
+
+/***********************************************************/
+
+/*
+    QSBR thread keeps counter == 1 while online, and lns->version is
+    the version of last quiescent state. For the worker it looks like
+    a thread in a read section entered with that version, so nothing
+    holding newer versions could be freed.
+*/
+void __lrcu_quiescent_state_ns(u8 ns_id){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    u64 version;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    if(ns->flavor != LRCU_FLAVOR_QSBR)
+        return;
+    LRCU_ASSERT(ti);
+    lrcu_read_cache_set(ti, ns);
+    version = LRCU_GET_LNS(ti, ns)->version;
+
+    /* everything read before is not used anymore */
+    mb();
+    LRCU_GET_LNS(ti, ns)->version = ns->version;
+    lrcu_sync_wake_check(&ns->sync_wait, version);
+}
+LRCU_EXPORT_SYMBOL(__lrcu_quiescent_state_ns);
+
+void lrcu_thread_online_ns(u8 ns_id){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    lrcu_local_namespace_t *lns;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+    LRCU_ASSERT(ns->flavor == LRCU_FLAVOR_QSBR);
+
+    LRCU_ASSERT(ti);
+    lns = LRCU_GET_LNS(ti, ns);
+    LRCU_ASSERT(lns->counter == 0);
+
+    lns->counter = 1;
+    barrier(); /* counter first, version after. same as read_lock */
+    lns->version = ns->version;
+    mb();
+}
+LRCU_EXPORT_SYMBOL(lrcu_thread_online_ns);
+
+void lrcu_thread_offline_ns(u8 ns_id){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    lrcu_local_namespace_t *lns;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+    LRCU_ASSERT(ns->flavor == LRCU_FLAVOR_QSBR);
+
+    LRCU_ASSERT(ti);
+    lns = LRCU_GET_LNS(ti, ns);
+    LRCU_ASSERT(lns->counter == 1);
+
+    /* everything read before is not used anymore */
+    mb();
+    lns->counter = 0;
+    lrcu_sync_wake_check(&ns->sync_wait, lns->version);
+}
+LRCU_EXPORT_SYMBOL(lrcu_thread_offline_ns);
+
+/***********************************************************/
+
+/*
+    Context takes a leaf slot of its own, marked in leaf->ctx: scanned
+    as one more thread, but with no thread_info behind it, so no hazard
+    slots, call queue or record cache. Only ordering between lock and
+    unlock on different threads is the one caller uses to pass the
+    context over (scheduler queue, mutex, etc.).
+*/
+struct lrcu_reader_ctx *lrcu_reader_ctx_init(u8 ns_id){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_reader_ctx *ctx;
+    struct lrcu_namespace *ns;
+    struct lrcu_leaf *leaf;
+    u32 bit;
+
+    LRCU_ASSERT(h);
+
+    lrcu_spin_lock(&h->ns_lock);
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+    lrcu_spin_unlock(&h->ns_lock);
+
+    ctx = LRCU_CALLOC(1, sizeof(struct lrcu_reader_ctx));
+    if(ctx == NULL)
+        return NULL;
+
+    lrcu_spin_lock(&ns->threads_lock);
+    ctx->slot = lrcu_ns_slot_take(ns);
+    if(ctx->slot == 0){
+        lrcu_spin_unlock(&ns->threads_lock);
+        LRCU_FREE(ctx);
+        return NULL;
+    }
+    leaf = ns->leaves[LRCU_SLOT_LEAF(ctx->slot)];
+    bit = LRCU_SLOT_BIT(ctx->slot);
+    leaf->slots[bit].lns.counter = 0;
+    leaf->slots[bit].lns.version = 0;
+    leaf->ctx |= 1ULL << bit;
+    lrcu_spin_unlock(&ns->threads_lock);
+
+    ctx->ns = ns;
+    ctx->ns_id = ns_id;
+    ctx->leaf = leaf;
+    ctx->lns = &leaf->slots[bit].lns;
+    ctx->dirty = &leaf->dirty;
+    return ctx;
+}
+LRCU_EXPORT_SYMBOL(lrcu_reader_ctx_init);
+
+void lrcu_reader_ctx_deinit(struct lrcu_reader_ctx *ctx){
+    struct lrcu_namespace *ns;
+
+    if(ctx == NULL)
+        return;
+
+    ns = ctx->ns;
+    LRCU_ASSERT(ctx->lns->counter == 0);
+
+    lrcu_spin_lock(&ns->threads_lock);
+    lrcu_ns_slot_put(ns, ctx->leaf, LRCU_SLOT_BIT(ctx->slot));
+    lrcu_spin_unlock(&ns->threads_lock);
+
+    LRCU_FREE(ctx);
+}
+LRCU_EXPORT_SYMBOL(lrcu_reader_ctx_deinit);
+
+/* same as __lrcu_read_lock_ns, but on context's lns. any flavor */
+void lrcu_read_lock_ctx(struct lrcu_reader_ctx *ctx){
+    struct lrcu_namespace *ns = ctx->ns;
+    lrcu_local_namespace_t *lns = ctx->lns;
+
+    if(LRCU_FLAVOR_IS_PERCPU(ns->flavor)){
+        lrcu_percpu_read_lock(ns, lns);
+        return;
+    }
+
+    /* QSBR worker scan is the same, so counter works there too */
+    lns->counter++;
+    barrier(); /* counter first, version after. see worker thread read order */
+    if(likely(lns->counter == 1)){
+        lns->version = ns->version;
+        if(ns->flavor == LRCU_FLAVOR_MEMBARRIER)
+            barrier();
+        else if(ns->flavor == LRCU_FLAVOR_FENCE)
+            mb(); /* before the mark */
+        else
+            wmb();
+        if(LRCU_FLAVOR_MARKS_LEAF(ns->flavor))
+            lrcu_leaf_mark_dirty(ctx->dirty, ns->flavor);
+    }
+}
+LRCU_EXPORT_SYMBOL(lrcu_read_lock_ctx);
+
+void lrcu_read_unlock_ctx(struct lrcu_reader_ctx *ctx){
+    struct lrcu_namespace *ns = ctx->ns;
+    lrcu_local_namespace_t *lns = ctx->lns;
+
+    if(LRCU_FLAVOR_IS_PERCPU(ns->flavor)){
+        lrcu_percpu_read_unlock(ns, lns);
+        return;
+    }
+
+    LRCU_ASSERT(lns->counter > 0);
+    if(lns->counter != 1){
+        lns->counter--;
+    }else{
+        /* between protected data access and actual destruction of the object */
+        barrier();
+        lns->counter--;
+        barrier();
+        lrcu_sync_wake_check(&ns->sync_wait, lns->version);
+    }
+}
+LRCU_EXPORT_SYMBOL(lrcu_read_unlock_ctx);
+
+/***********************************************************/
+
+void *__lrcu_dereference(void **ptr){
+    void *p = ACCESS_ONCE(*ptr);
+
+    read_barrier_depends();
+    return p;
+}
+LRCU_EXPORT_SYMBOL(__lrcu_dereference);
+
+void *lrcu_dereference_ptr(struct lrcu_ptr *ptr){
+    void *p = ACCESS_ONCE(ptr->ptr);
+
+    read_barrier_depends();
+    return p;
+}
+LRCU_EXPORT_SYMBOL(lrcu_dereference_ptr);
+
+/*
+    refcount starts at 0. Worker, once grace period is over, drops its
+    own share, and readers drop theirs on put. Whoever gets -1 is last
+    and destroys it. get is only called inside read section, so it
+    always comes before worker's decrement and never sees -1.
+    lrcu_call_head_ns() sets -1 itself, so its heads need no init.
+*/
+void lrcu_ptr_head_init(struct lrcu_ptr_head *head){
+    head->refcount = 0;
+}
+LRCU_EXPORT_SYMBOL(lrcu_ptr_head_init);
+
+void lrcu_ptr_head_get(struct lrcu_ptr_head *head){
+    LRCU_ASSERT(head->refcount >= 0);
+    lrcu_atomic_inc(&head->refcount);
+}
+LRCU_EXPORT_SYMBOL(lrcu_ptr_head_get);
+
+void lrcu_ptr_head_put(struct lrcu_ptr_head *head){
+    /* worker passed it already, grace period is over */
+    if(lrcu_atomic_dec(&head->refcount) == -1)
+        head->func(head);
+}
+LRCU_EXPORT_SYMBOL(lrcu_ptr_head_put);
+
+void *__lrcu_dereference_get(void **ptr, size_t head_offset){
+    void *p = __lrcu_dereference(ptr);
+
+    if(p)
+        lrcu_ptr_head_get((struct lrcu_ptr_head *)((char *)p + head_offset));
+    return p;
+}
+LRCU_EXPORT_SYMBOL(__lrcu_dereference_get);
+
+/***********************************************************/
+
+/*
+    Classic hazard pointer: publish, full barrier, check pointer is still
+    there. Writer unpublishes before lrcu_call, worker reads slots after
+    a full barrier, so it either sees the slot or we see new pointer.
+*/
+void *__lrcu_hazard_protect_ns(u8 ns_id, u8 slot, void **ptr,
+                                            size_t head_offset){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    void **hazard;
+    void *p;
+
+    LRCU_ASSERT(h);
+    LRCU_ASSERT(ti);
+    LRCU_ASSERT(slot < LRCU_HAZARDS_MAX);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+    /* worker reads slots of registered threads only */
+    LRCU_ASSERT(ti->leaf[ns_id]);
+
+    if(unlikely(!ns->hazards))
+        ns->hazards = true; /* worker starts checking slots */
+
+    hazard = &ti->hazards[ns_id][slot];
+    p = ACCESS_ONCE(*ptr);
+    while(1){
+        void *p2;
+
+        ACCESS_ONCE(*hazard) = p ? (char *)p + head_offset : NULL;
+        mb();
+        p2 = ACCESS_ONCE(*ptr);
+        if(p2 == p)
+            break;
+        p = p2;
+    }
+    read_barrier_depends();
+    return p;
+}
+LRCU_EXPORT_SYMBOL(__lrcu_hazard_protect_ns);
+
+void lrcu_hazard_release_ns(u8 ns_id, u8 slot){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+
+    LRCU_ASSERT(h);
+    LRCU_ASSERT(ti);
+    LRCU_ASSERT(slot < LRCU_HAZARDS_MAX);
+
+    /* between protected data access and slot release */
+    barrier();
+    ACCESS_ONCE(ti->hazards[ns_id][slot]) = NULL;
+
+    /*
+        Worker parks with callbacks only hazard slots hold. No full
+        barrier before the check, so release racing with worker's pass
+        is seen by its next one, LRCU_WORKER_PARK_US later at most.
+    */
+    ns = h->ns[ns_id];
+    if(unlikely(ns && ACCESS_ONCE(ns->segs_held)))
+        lrcu_worker_wake(h, true);
+}
+LRCU_EXPORT_SYMBOL(lrcu_hazard_release_ns);
+
+/***********************************************************/
+
+/*
+    Callback records go thread cache -> call queue -> worker -> h->pool,
+    and back to caches LRCU_CALL_POOL_BATCH at a time. Threads only try
+    pool_lock: with the pool busy or empty they take a new chunk of
+    LRCU_CALL_POOL_BATCH records instead of waiting behind each other.
+*/
+static lrcu_list_t *lrcu_call_pool_take(struct lrcu_handler *h,
+                                                u32 max, u32 *taken){
+    struct lrcu_call_chunk *chunk, *old;
+    lrcu_list_t *first, *e;
+    u32 n = 1;
+
+    *taken = 0;
+    if(lrcu_spin_trylock(&h->pool_lock) == 0){
+        if(!lrcu_queue_empty(&h->pool)){
+            first = e = h->pool.lh.head;
+            while(n < max && e->next){
+                e = e->next;
+                n++;
+            }
+            h->pool.lh.head = e->next;
+            lrcu_spin_unlock(&h->pool_lock);
+            e->next = NULL;
+            *taken = n;
+            return first;
+        }
+        lrcu_spin_unlock(&h->pool_lock);
+    }
+
+    chunk = LRCU_MALLOC(sizeof(struct lrcu_call_chunk) +
+                            LRCU_CALL_POOL_BATCH * LRCU_CALL_RECORD_SIZE);
+    if(chunk == NULL)
+        return NULL;
+    do{
+        old = ACCESS_ONCE(h->pool_chunks);
+        chunk->next = old;
+    }while(lrcu_cmpxchg(&h->pool_chunks, old, chunk) != old);
+
+    first = NULL;
+    for(n = LRCU_CALL_POOL_BATCH; n-- > 0;){
+        e = (lrcu_list_t *)((char *)chunk->records + n * LRCU_CALL_RECORD_SIZE);
+        e->next = first;
+        first = e;
+    }
+    *taken = LRCU_CALL_POOL_BATCH;
+    return first;
+}
+
+static void lrcu_call_pool_give(struct lrcu_handler *h, lrcu_list_t *chain){
+    lrcu_spin_lock(&h->pool_lock);
+    lrcu_queue_splice_chain(&h->pool, chain);
+    lrcu_spin_unlock(&h->pool_lock);
+}
+
+/* worker returns records of one pass */
+static void lrcu_call_pool_put(struct lrcu_handler *h, lrcu_queue_head_t *q){
+    if(lrcu_queue_empty(q))
+        return;
+    lrcu_spin_lock(&h->pool_lock);
+    lrcu_queue_splice(&h->pool, q);
+    lrcu_spin_unlock(&h->pool_lock);
+}
+
+static void lrcu_call_cache_drain(struct lrcu_handler *h,
+                                            struct lrcu_call_cache *c){
+    if(c->len == 0)
+        return;
+    lrcu_call_pool_give(h, c->head);
+    c->head = NULL;
+    c->len = 0;
+}
+
+/* threads without thread_info have no cache, rest of a new chunk goes to pool */
+static inline lrcu_list_t *lrcu_call_record_get(struct lrcu_handler *h,
+                                            struct lrcu_thread_info *ti){
+    struct lrcu_call_cache *c;
+    lrcu_list_t *e;
+    u32 n;
+
+    if(ti == NULL){
+        e = lrcu_call_pool_take(h, 1, &n);
+        if(e && e->next){
+            lrcu_call_pool_give(h, e->next);
+            e->next = NULL;
+        }
+        return e;
+    }
+    c = &ti->cache;
+    if(c->len == 0){
+        c->head = lrcu_call_pool_take(h, LRCU_CALL_POOL_BATCH, &c->len);
+        if(c->head == NULL)
+            return NULL;
+    }
+    e = c->head;
+    c->head = e->next;
+    c->len--;
+    return e;
+}
+
+/*
+    Registered thread queues callbacks in its own call queue and marks
+    it in leaf->calls, NULL if it is not registered in ns. Lock is a full
+    barrier, so the worker sees the lock or the mark before we read the
+    version. See lrcu_ns_harvest.
+*/
+static inline struct lrcu_call_queue *lrcu_call_queue_lock(
+                    struct lrcu_thread_info *ti, struct lrcu_namespace *ns){
+    struct lrcu_call_queue *q;
+    struct lrcu_leaf *leaf;
+    u64 bit;
+
+    if(ti == NULL || ti->leaf[ns->id] == NULL)
+        return NULL;
+    leaf = ti->leaf[ns->id];
+    q = &ti->calls[ns->id];
+    bit = 1ULL << LRCU_SLOT_BIT(ti->slot[ns->id]);
+
+    lrcu_spin_lock(&q->lock);
+    if(!(ACCESS_ONCE(leaf->calls) & bit))
+        lrcu_atomic_or(&leaf->calls, bit);
+    return q;
+}
+
+void lrcu_call_ns(u8 ns_id, void *p, lrcu_destructor_t *destr){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_namespace *ns;
+    struct lrcu_call_queue *q;
+    struct lrcu_ptr *ptr;
+    lrcu_list_t *e;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    e = lrcu_call_record_get(h, ti);
+    if(unlikely(e == NULL)){
+        /* no memory for a record. wait here, never drop the callback */
+        lrcu_synchronize_ns(ns_id);
+        destr(p);
+        return;
+    }
+    ptr = (struct lrcu_ptr *)e->data;
+    ptr->ptr = p;
+    ptr->deinit = destr;
+    ptr->ns_id = ns_id;
+
+    q = lrcu_call_queue_lock(ti, ns);
+    if(q){
+        ptr->version = ns->version;
+        lrcu_queue_insert(&q->list, e);
+        lrcu_call_bounds_add(&q->bounds, ptr->version);
+        lrcu_spin_unlock(&q->lock);
+        lrcu_worker_wake(h, false);
+        return;
+    }
+
+    /* unregistered thread. shared list */
+#ifdef LRCU_LIST_ATOMIC
+    ptr->version = ns->version; /* synchronize() will be called on this version */
+    lrcu_list_insert_atomic(&ns->free_list.lh, e);
+#else
+    lrcu_spin_lock(&ns->list_lock);
+    /* under lock, so worker's version snapshot is ordered with us */
+    ptr->version = ns->version;
+    lrcu_queue_insert(&ns->free_list, e);
+    lrcu_call_bounds_add(&ns->free_bounds, ptr->version);
+    lrcu_spin_unlock(&ns->list_lock);
+#endif
+    lrcu_worker_wake(h, false);
+}
+LRCU_EXPORT_SYMBOL(lrcu_call_ns);
+
+/***********************************************************/
+
+/*
+    Queue heads first..last, linked through list.next, under one lock
+    and one version. The version lands in first head and in queue bounds,
+    which is what the worker checks.
+*/
+static void lrcu_call_heads(struct lrcu_handler *h, struct lrcu_namespace *ns,
+                struct lrcu_ptr_head *first, struct lrcu_ptr_head *last){
+    lrcu_queue_head_t chain = { { &first->list }, &last->list };
+    struct lrcu_call_queue *q;
+
+    last->list.next = NULL;
+    q = lrcu_call_queue_lock(LRCU_GET_TI(), ns);
+    if(q){
+        first->version = ns->version;
+        lrcu_queue_splice(&q->hlist, &chain);
+        lrcu_call_bounds_add(&q->bounds, first->version);
+        lrcu_spin_unlock(&q->lock);
+        lrcu_worker_wake(h, false);
+        return;
+    }
+
+#ifdef LRCU_LIST_ATOMIC
+    first->version = ns->version;
+    lrcu_list_insert_chain_atomic(&ns->free_hlist.lh, &first->list, &last->list);
+#else
+    lrcu_spin_lock(&ns->list_hlock);
+    first->version = ns->version; /* see lrcu_call_ns */
+    lrcu_queue_splice(&ns->free_hlist, &chain);
+    lrcu_call_bounds_add(&ns->free_hbounds, first->version);
+    lrcu_spin_unlock(&ns->list_hlock);
+#endif
+    lrcu_worker_wake(h, false);
+}
+
+static void __lrcu_call_head_ns(u8 ns_id, struct lrcu_ptr_head *head,
+                                    lrcu_destructor_t *destr){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    head->func = destr;
+    head->ns_id = ns_id;
+    lrcu_call_heads(h, ns, head, head);
+}
+
+void lrcu_call_head_ns(u8 ns_id, struct lrcu_ptr_head *head,
+                                    lrcu_destructor_t *destr){
+    head->refcount = -1; /* not tracked, worker destroys it */
+    __lrcu_call_head_ns(ns_id, head, destr);
+}
+LRCU_EXPORT_SYMBOL(lrcu_call_head_ns);
+
+void lrcu_call_head_ref_ns(u8 ns_id, struct lrcu_ptr_head *head,
+                                    lrcu_destructor_t *destr){
+    LRCU_ASSERT(head->refcount >= 0);
+    __lrcu_call_head_ns(ns_id, head, destr);
+}
+LRCU_EXPORT_SYMBOL(lrcu_call_head_ref_ns);
+
+void lrcu_call_head_batch_ns(u8 ns_id, struct lrcu_ptr_head *first,
+                                            lrcu_destructor_t *destr){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_ptr_head *last = first;
+    struct lrcu_namespace *ns;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    if(first == NULL)
+        return;
+    for(;;){
+        last->func = destr;
+        last->ns_id = ns_id;
+        last->refcount = -1;
+        if(last->list.next == NULL)
+            break;
+        last = container_of(last->list.next, struct lrcu_ptr_head, list);
+    }
+    lrcu_call_heads(h, ns, first, last);
+}
+LRCU_EXPORT_SYMBOL(lrcu_call_head_batch_ns);
+
+/* whole batch is one head. see lrcu_hazard_find_head */
+static void lrcu_call_batch_run(void *p){
+    struct lrcu_call_batch *b = container_of(p, struct lrcu_call_batch, head);
+    size_t i;
+
+    for(i = 0; i < b->n; i++)
+        b->destr(b->ptrs[i]);
+    LRCU_FREE(b);
+}
+
+void lrcu_call_batch_ns(u8 ns_id, void **ptrs, size_t n,
+                                            lrcu_destructor_t *destr){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_call_batch *b;
+    struct lrcu_namespace *ns;
+    size_t i;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    if(n == 0)
+        return;
+    b = LRCU_MALLOC(sizeof(struct lrcu_call_batch) + n * sizeof(void *));
+    if(b == NULL){
+        for(i = 0; i < n; i++)
+            lrcu_call_ns(ns_id, ptrs[i], destr);
+        return;
+    }
+    memcpy(b->ptrs, ptrs, n * sizeof(void *));
+    b->n = n;
+    b->destr = destr;
+    b->head.refcount = -1;
+    b->head.func = lrcu_call_batch_run;
+    b->head.ns_id = ns_id;
+    lrcu_call_heads(h, ns, &b->head, &b->head);
+}
+LRCU_EXPORT_SYMBOL(lrcu_call_batch_ns);
+
+/***********************************************************/
+
+/*
+Corner cases.
+sequence 1:
+    write_lock(v = 1)
+    assign_ptr
+    lrcu_call(p, v = 1)
+                            read_lock(v = 1) 
+                            deref_ptr(p)                         <---- this cannot happen in correct code(barriers etc.)
+                                                worker_thread(p) <---- we here
+    write_unlock
+                            ...
+                            read_unlock
+**************************************************************
+sequence 2:
+    write_lock(v = 1)
+                            read_lock(v = 1)
+                            deref_ptr(p)
+    assign_ptr
+    lrcu_call(p, v = 1)
+                                                worker_thread(p, v = 1) <---- we here. 
+                                                                        1 == 1 => we cannot free it
+                                                                        we should wait until counter == 0
+    write_unlock
+                            ...
+                            read_unlock
+*/
+/*
+    LRCU_FLAVOR_PERCPU. Epoch which is not current gets no new readers,
+    except those who fetched pcpu_idx right before the flip. Once it is
+    drained, every reader that started before the last flip is gone,
+    so callbacks with versions before pcpu_flip_version are safe.
+    Then flip again. Caller holds threads_lock.
+*/
+static inline void __lrcu_percpu_get_synchronized(struct lrcu_namespace *ns,
+                                lrcu_rangetree_t *rbt, u64 current_version){
+    u32 old_idx = (ns->pcpu_idx & 1) ^ 1;
+    u64 locks = 0, unlocks = 0;
+    u32 i;
+
+    mb();
+    /* unlocks first. reader could lock and unlock between two loops */
+    for(i = 0; i < ns->nr_cpus; i++)
+        unlocks += ACCESS_ONCE(ns->pcpu[i].unlock[old_idx]);
+    mb();
+    for(i = 0; i < ns->nr_cpus; i++)
+        locks += ACCESS_ONCE(ns->pcpu[i].lock[old_idx]);
+
+    if(locks == unlocks){
+        ns->pcpu_safe_version = ns->pcpu_flip_version;
+        ns->pcpu_flip_version = current_version;
+        mb();
+        ns->pcpu_idx++;
+        mb();
+    }
+
+    if(ns->pcpu_safe_version <= current_version)
+        lrcu_rangetree_add(rbt, ns->pcpu_safe_version, current_version);
+}
+
+/* scan reads clock at most once, and only if some thread is in section */
+struct lrcu_scan_clock {
+    LRCU_TIMER_TYPE now;
+    bool set;
+};
+
+static inline LRCU_TIMER_TYPE *lrcu_scan_now(struct lrcu_scan_clock *clock){
+    if(!clock->set){
+        LRCU_TIMER_GET(&clock->now);
+        clock->set = true;
+    }
+    return &clock->now;
+}
+
+/* returns true if thread is in read section */
+static inline bool lrcu_scan_thread(struct lrcu_leaf *leaf, u32 b,
+                    lrcu_rangetree_t *rbt, u64 current_version,
+                    struct lrcu_scan_clock *clock){
+    LRCU_TIMER_TYPE *ti_timeval = &leaf->state[b].timeval;
+    struct lrcu_local_namespace lns;
+    struct lrcu_local_namespace hung_lns;
+
+    lns = leaf->slots[b].lns;
+    hung_lns = leaf->state[b].hung_lns;
+    /* read lns. both counter and version */
+    barrier();
+    /*
+        Calculate thread's safe release version.
+        init. lns.version = 0, counter = 0
+        thread1 enters and leaves write section, ns->version = 1
+        thread2 enters and leaves write section, ns->version = 2, lrcu_call ptr, version = 2
+        thread3 enters read section, counter = 1, version = 2
+        worker wakes up, reads thread's lns, version = 2, counter = 1,
+                        init timeval = now, set hung_lns.version = 2, counter = 1,
+        worker wakes up, reads thread's lns, version = 2, counter = 1,
+                        reads timeval, checks timeout criteria, not timed out
+                        check hung_lns.version against lns.version, if less,
+                        thread woke up after last read section, and entered it again,
+                        with another ns version, if more or equal, thread either woke up and 
+                        entered read section with same verison, or never left previous
+                        so hung_lns.version == lns.version, therefore same version,
+                        add [hung_lns.version, current_version] to rbt,
+                        cannot free ptr with version = 2
+        worker wakes up, reads thread's lns, version = 2, counter = 1,
+                        reads timeval, checks timeout criteria, timed out,
+                        so hung_lns.version == lns.version,
+                        add [hung_lns.version, current_version] to rbt,
+                        marked thread as hung
+                        set hung_lns.version to current_version
+                        cannot free ptr with version = 2
+... 10 timutes pased
+        worker wakes up, reads thread's lns, version = 2, counter = 1,
+                        usual threads all empty, checking hung thread
+                        counter = 1 and hung_lns.version == lns.version, still hanging,
+                        add [lns.version, hung_lns.version] to rbt,
+                        cannot free ptr with version = 2
+        thread2 enters and leaves write section, ns->version = 3, lrcu_call ptr, version = 3
+        worker wakes up, reads thread's lns, version = 2, counter = 1,
+                        usual threads all empty, checking hung thread
+                        counter = 1 and hung_lns.version == lns.version, still hanging,
+                        add [lns.version, hung_lns.version] to rbt,
+                        cannot free ptr with version = 2
+                        can free ptr with version = 3
+        thread3 leaves read section, counter = 0, version = 2
+... thread 3 keeps working with more recent data, but does not considered as such,
+thus data gets freed, so incorrect behaviour.
+        thread3 enters read section, counter = 1, version = 3
+        worker wakes up, reads thread's lns, version = 3, counter = 1,
+                        usual threads all empty, checking hung thread
+                        counter = 1 and hung_lns.version < lns.version, 
+                        something happened, data moved forward, 
+                        clear thread's hung mark
+                        add [lns.version, current_version] to rbt,
+                        can free ptr with version = 2
+        worker wakes up, reads thread's lns, version = 2, counter = 0,
+                        nothing to add to lrcu_rangetree
+    */
+    if(lns.counter == 0){
+        /* corner case 2: we have current version + 1 */
+        LRCU_TIMER_CLEAR(ti_timeval); /* reset hanging thread timer */
+        return false;
+    }
+
+    lrcu_rangetree_add(rbt, lns.version, current_version);
+    /* 
+        Handling hung thread case.
+        We use hung_lns in usual threads to identify hung threads
+                        in hung threads to identify unfeasable version range for thread
+     */
+    /* we will know that hung thread unhang if we past current_version */
+
+    if(likely(LRCU_TIMER_ISSET(ti_timeval))){ /* hanging timer initialized */
+        /* we are the only ones who has access to hung lns */
+        if(lns.version <= hung_lns.version){
+            const LRCU_TIMER_TYPE timeout =
+                        LRCU_TIMER_INIT(LRCU_HANG_TIMEOUT_S, 0);
+            LRCU_TIMER_TYPE timer_expires;
+
+            LRCU_TIMER_ADD(ti_timeval, &timeout, &timer_expires);
+            if(unlikely(!LRCU_TIMER_CMP(lrcu_scan_now(clock), &timer_expires, <))){ /* !< is >= */
+                /* timer expired. thread sleeps too long in read-section 
+                    mark thread as hanging and check it separately */
+
+                LRCU_WARN("hung thread");
+                leaf->hung |= 1ULL << b;
+            }
+        }
+    }else{
+        *ti_timeval = *lrcu_scan_now(clock);
+    }
+    lns.version = current_version; /* record version in which we hang */
+    leaf->state[b].hung_lns = lns;
+    return true;
+}
+
+/* the point of hang thread, that it has hang version */
+static inline bool lrcu_scan_hung_thread(struct lrcu_leaf *leaf, u32 b,
+                    lrcu_rangetree_t *rbt, u64 current_version){
+    struct lrcu_local_namespace lns, hung_lns;
+
+    hung_lns = leaf->state[b].hung_lns;
+    lns = leaf->slots[b].lns;
+    /* read lns and hung_lns */
+    barrier();
+    if(lns.version > hung_lns.version || lns.counter == 0){
+        /* we have been changed after we hung */
+        leaf->hung &= ~(1ULL << b);
+    }
+
+    if(lns.counter == 0)
+        return false;
+    if(lns.version > hung_lns.version)
+        lrcu_rangetree_add(rbt, lns.version, current_version);
+    else
+        lrcu_rangetree_add(rbt, lns.version, hung_lns.version);
+
+    /* 
+        unfeasable version range is [lns->version, hung_lns->version]
+        we can use max version only if all other (usual)threads have 
+        either zero counter, or have known hang point(version)
+    */
+    return true;
+}
+
+/* returns version the scan was made against */
+static inline u64 __lrcu_get_synchronized(struct lrcu_namespace *ns, lrcu_rangetree_t *rbt){
+    struct lrcu_scan_clock clock = { .set = false };
+    u64 current_version, bits;
+    bool skip_clean, scanned = false;
+    u32 l, b;
+
+    current_version = ns->version;
+
+    if(LRCU_FLAVOR_IS_PERCPU(ns->flavor)){
+        lrcu_spin_lock(&ns->threads_lock);
+        __lrcu_percpu_get_synchronized(ns, rbt, current_version);
+        lrcu_spin_unlock(&ns->threads_lock);
+        lrcu_rangetree_optimize(rbt, RANGE_BINTREE_OPTLEVEL_MERGE);
+        return current_version;
+    }
+
+    /*
+        Readers mark their leaf after counter and version, see
+        lrcu_leaf_mark_dirty. Flags are cleared, full barrier is issued
+        (forced on every running thread for MEMBARRIER), flags are read
+        again, and only marked leaves are scanned. A reader that skipped
+        the mark because it saw the flag set has its counter visible to
+        this scan, and a leaf with anybody in section stays marked for
+        the next one. A reader whose mark we miss did its protected loads
+        after our barrier, when unpublished objects were already gone.
+    */
+    lrcu_spin_lock(&ns->threads_lock);
+    skip_clean = LRCU_FLAVOR_MARKS_LEAF(ns->flavor);
+    if(skip_clean){
+        for(l = 0; l < ns->nr_leaves; l++)
+            ns->leaves[l]->scan = lrcu_xchg(&ns->leaves[l]->dirty, 0);
+        if(ns->flavor == LRCU_FLAVOR_MEMBARRIER)
+            LRCU_MEMBARRIER();
+        else
+            mb();
+        for(l = 0; l < ns->nr_leaves; l++)
+            ns->leaves[l]->scan |= ACCESS_ONCE(ns->leaves[l]->dirty);
+    }
+
+    for(l = 0; l < ns->nr_leaves; l++){
+        struct lrcu_leaf *leaf = ns->leaves[l];
+        bool busy = false;
+
+        if(skip_clean && !leaf->scan)
+            continue;
+        scanned = true;
+        lrcu_leaf_for_each_slot(leaf, bits, b){
+            if(leaf->hung & (1ULL << b))
+                busy |= lrcu_scan_hung_thread(leaf, b, rbt, current_version);
+            else
+                busy |= lrcu_scan_thread(leaf, b, rbt, current_version,
+                                                                    &clock);
+        }
+        /* reader could stay in section without entering it again */
+        if(skip_clean && busy)
+            ACCESS_ONCE(leaf->dirty) = 1;
+    }
+    lrcu_spin_unlock(&ns->threads_lock);
+    /*
+        Readers leave with a compiler barrier only: their reads of
+        protected data must be done before callbacks free it. Same as
+        after lrcu_synchronize_spin(). Nothing to order if no one was seen.
+    */
+    if(ns->flavor == LRCU_FLAVOR_MEMBARRIER && scanned)
+        LRCU_MEMBARRIER();
+    lrcu_rangetree_optimize(rbt, RANGE_BINTREE_OPTLEVEL_MERGE);
+    return current_version;
+}
+
+/*
+    Grace period bookkeeping for lrcu_poll_state_ns(). gp_completed only
+    moves after an actual scan: versions below it have no readers left.
+    Worker and synchronize() callers update it concurrently.
+*/
+static inline void lrcu_gp_completed_advance(struct lrcu_namespace *ns,
+                                                            u64 version){
+    u64 old;
+
+    while((old = ACCESS_ONCE(ns->gp_completed)) < version){
+        if(lrcu_cmpxchg(&ns->gp_completed, old, version) == old)
+            break;
+    }
+}
+
+static inline void lrcu_gp_completed_update(struct lrcu_namespace *ns,
+                            lrcu_rangetree_t *rbt, u64 current_version){
+    /* readers can still enter with current_version after the scan */
+    u64 completed = current_version;
+
+    if(rbt->len && lrcu_rangetree_getmin(rbt) < completed)
+        completed = lrcu_rangetree_getmin(rbt);
+    lrcu_gp_completed_advance(ns, completed);
+}
+
+static inline bool lrcu_gp_requested(struct lrcu_namespace *ns){
+    return ACCESS_ONCE(ns->gp_requested) >= ACCESS_ONCE(ns->gp_completed);
+}
+
+/*
+    Collect hazard slots of all threads of ns. Returns number of slots,
+    or max + 1 if they did not fit, then everything counts as protected.
+*/
+static inline size_t __lrcu_get_hazards(struct lrcu_namespace *ns,
+                                                void **hz, size_t max){
+    struct lrcu_thread_info *ti;
+    size_t len = 0, j;
+    u64 bits;
+    u32 l;
+
+    /* pairs with mb() in __lrcu_hazard_protect_ns */
+    mb();
+    lrcu_spin_lock(&ns->threads_lock);
+    for(l = 0; l < ns->nr_leaves; l++){
+        lrcu_leaf_for_each(ns->leaves[l], bits, ti){
+            for(j = 0; j < LRCU_HAZARDS_MAX; j++){
+                void *p = ACCESS_ONCE(ti->hazards[ns->id][j]);
+
+                if(p == NULL)
+                    continue;
+                if(len == max){
+                    lrcu_spin_unlock(&ns->threads_lock);
+                    return max + 1;
+                }
+                hz[len++] = p;
+            }
+        }
+    }
+    lrcu_spin_unlock(&ns->threads_lock);
+    return len;
+}
+
+/*
+    Worker's hazard buffer follows ns->nr_threads. Thread added after we
+    looked makes __lrcu_get_hazards() overflow: that pass frees nothing
+    protected by anybody, and the next one grows the buffer.
+*/
+static void **lrcu_hazards_grow(void **hz, size_t *max, u32 nr_threads){
+    size_t need = (size_t)nr_threads * LRCU_HAZARDS_MAX;
+    void **grown;
+
+    if(need <= *max)
+        return hz;
+    grown = LRCU_CALLOC(need, sizeof(void *));
+    if(grown == NULL)
+        return hz; /* keep overflowing, still safe */
+    LRCU_FREE(hz);
+    *max = need;
+    return grown;
+}
+
+static inline bool lrcu_hazard_find(void **hz, size_t len, size_t max,
+                                                                void *p){
+    size_t i;
+
+    if(len > max)
+        return true;
+    for(i = 0; i < len; i++)
+        if(hz[i] == p)
+            return true;
+    return false;
+}
+
+/* batch waits as a whole while any of its pointers is protected */
+static inline bool lrcu_hazard_find_head(void **hz, size_t len, size_t max,
+                                                struct lrcu_ptr_head *h){
+    struct lrcu_call_batch *b;
+    size_t i;
+
+    if(lrcu_hazard_find(hz, len, max, h))
+        return true;
+    if(len == 0 || h->func != lrcu_call_batch_run)
+        return false;
+    b = container_of(h, struct lrcu_call_batch, head);
+    for(i = 0; i < b->n; i++)
+        if(lrcu_hazard_find(hz, len, max, b->ptrs[i]))
+            return true;
+    return false;
+}
+
+static bool lrcu_ns_destructor(struct lrcu_namespace *ns, bool forced){
+    struct lrcu_thread_info *ti;
+    u64 bits;
+    u32 l;
+
+    lrcu_spin_lock(&ns->threads_lock);
+    for(l = 0; l < ns->nr_leaves; l++){
+        struct lrcu_leaf *leaf = ns->leaves[l];
+
+        lrcu_leaf_for_each(leaf, bits, ti){
+            if(forced || (LRCU_GET_LNS(ti, ns)->counter == 0 &&
+                        LRCU_GET_LNS(ti, ns)->version >= ns->version))
+                lrcu_ns_thread_del(ns, ti);
+        }
+        /* unforced, contexts keep ns until lrcu_reader_ctx_deinit() */
+        if(forced){
+            for(bits = leaf->ctx; bits; bits &= bits - 1)
+                lrcu_ns_slot_put(ns, leaf, __builtin_ctzll(bits));
+        }
+    }
+    /* removed threads could leave callbacks in free lists, run them first */
+    if(ns->nr_threads == 0 && (forced || (lrcu_queue_empty(&ns->free_list) &&
+                                    lrcu_queue_empty(&ns->free_hlist)))){
+        lrcu_spin_unlock(&ns->threads_lock);
+#ifdef LRCU_READ_INLINE
+        /* read caches of other threads still point here */
+        ACCESS_ONCE(__lrcu_ns_gen[ns->id]) = ns->gen + 1;
+        mb();
+#endif
+        lrcu_ns_leaves_free(ns);
+        if(ns->eventfd >= 0)
+            LRCU_EVENTFD_CLOSE(ns->eventfd);
+        LRCU_FREE(ns->pcpu);
+        LRCU_FREE(ns->spin_snap);
+        LRCU_FREE(ns);
+        return true;
+    }
+    lrcu_spin_unlock(&ns->threads_lock);
+    return false;
+}
+
+/*
+    Move callbacks from marked call queues to worker lists. Caller takes
+    queue lock, marks, then reads version; we read the version before
+    looking at marks and locks, so a queue we skip gets only callbacks
+    with that version or newer. Queue locked right now could be getting
+    an older one, it stays marked and false is returned: processed_version
+    must not move this pass. Version bounds of harvested queues go to batch.
+*/
+static bool lrcu_ns_harvest(struct lrcu_namespace *ns,
+                                        struct lrcu_call_bounds *batch){
+    bool harvested = true;
+    u64 calls;
+    u32 l, b;
+
+    lrcu_spin_lock(&ns->threads_lock);
+    for(l = 0; l < ns->nr_leaves; l++){
+        struct lrcu_leaf *leaf = ns->leaves[l];
+
+        if(ACCESS_ONCE(leaf->calls) == 0)
+            continue;
+        calls = lrcu_xchg(&leaf->calls, 0) & leaf->used;
+        for(; calls; calls &= calls - 1){
+            struct lrcu_call_queue *q;
+
+            b = __builtin_ctzll(calls);
+            q = &leaf->ti[b]->calls[ns->id];
+            if(lrcu_spin_trylock(&q->lock)){ /* busy */
+                lrcu_atomic_or(&leaf->calls, 1ULL << b);
+                harvested = false;
+                continue;
+            }
+            lrcu_queue_splice(&ns->worker_list, &q->list);
+            lrcu_queue_splice(&ns->worker_hlist, &q->hlist);
+            lrcu_call_bounds_take(batch, &q->bounds);
+            lrcu_spin_unlock(&q->lock);
+        }
+    }
+    lrcu_spin_unlock(&ns->threads_lock);
+    return harvested;
+}
+
+static bool lrcu_ns_has_calls(struct lrcu_namespace *ns){
+    bool ret = false;
+    u32 l;
+
+    lrcu_spin_lock(&ns->threads_lock);
+    for(l = 0; l < ns->nr_leaves && !ret; l++)
+        ret = ACCESS_ONCE(ns->leaves[l]->calls) != 0;
+    lrcu_spin_unlock(&ns->threads_lock);
+    return ret;
+}
+
+/*
+    Worker lists of this pass become one segment. With all segments
+    taken, the last one absorbs them and only gets wider bounds.
+*/
+static void lrcu_ns_segment_push(struct lrcu_namespace *ns,
+                                        struct lrcu_call_bounds *batch){
+    struct lrcu_call_segment *seg;
+
+    if(lrcu_queue_empty(&ns->worker_list) &&
+                    lrcu_queue_empty(&ns->worker_hlist))
+        return;
+    if(ns->nr_segs < LRCU_CALL_SEGMENTS)
+        seg = &ns->segs[ns->nr_segs++];
+    else
+        seg = &ns->segs[LRCU_CALL_SEGMENTS - 1];
+    lrcu_queue_splice(&seg->list, &ns->worker_list);
+    lrcu_queue_splice(&seg->hlist, &ns->worker_hlist);
+    lrcu_call_bounds_take(&seg->bounds, batch);
+}
+
+/* segment is past grace period. hazard protected callbacks stay in it */
+static size_t lrcu_segment_run(struct lrcu_call_segment *seg,
+                            void **hazards, size_t hz_len, size_t hz_max,
+                            lrcu_queue_head_t *recycled){
+    struct lrcu_ptr *ptr;
+    lrcu_list_t *n, *n_prev;
+    size_t freed = 0;
+
+    lrcu_list_for_each(n, n_prev, &seg->list.lh){
+        ptr = (struct lrcu_ptr *)n->data;
+        if(!lrcu_hazard_find(hazards, hz_len, hz_max, ptr->ptr)){
+            ptr->deinit(ptr->ptr);
+            lrcu_queue_unlink_next(&seg->list, n_prev);
+            lrcu_queue_insert(recycled, n);
+            freed++;
+        }
+    }
+    lrcu_list_for_each(n, n_prev, &seg->hlist.lh){
+        struct lrcu_ptr_head *h = container_of(n, struct lrcu_ptr_head, list);
+
+        if(!lrcu_hazard_find_head(hazards, hz_len, hz_max, h)){
+            lrcu_queue_unlink_next(&seg->hlist, n_prev);
+            /* else last lrcu_ptr_head_put() destroys it */
+            if(ACCESS_ONCE(h->refcount) == -1 ||
+                        lrcu_atomic_dec(&h->refcount) == -1)
+                h->func(h);
+            freed++;
+        }
+    }
+    return freed;
+}
+
+/*
+    Run segments no unsafe range touches, drop emptied ones. Returns
+    lowest version still waiting for readers, or max_version. Segments
+    that ran and still have callbacks are held by hazard slots only.
+*/
+static u64 lrcu_ns_segments_run(struct lrcu_namespace *ns,
+                    lrcu_rangetree_t *rbt, void **hazards, size_t hz_len,
+                    size_t hz_max, lrcu_queue_head_t *recycled,
+                    size_t *freed, u64 max_version){
+    u32 i, kept = 0, waiting = 0;
+
+    for(i = 0; i < ns->nr_segs; i++){
+        struct lrcu_call_segment *seg = &ns->segs[i];
+
+        if(!lrcu_rangetree_find_range(rbt, seg->bounds.minv, seg->bounds.maxv))
+            *freed += lrcu_segment_run(seg, hazards, hz_len, hz_max,
+                                                                recycled);
+        else{
+            waiting++;
+            if(seg->bounds.minv < max_version)
+                max_version = seg->bounds.minv;
+        }
+
+        if(lrcu_queue_empty(&seg->list) && lrcu_queue_empty(&seg->hlist)){
+            seg->bounds.minv = seg->bounds.maxv = 0;
+            continue;
+        }
+        if(kept != i){
+            ns->segs[kept] = *seg;
+            lrcu_queue_init(&seg->list);
+            lrcu_queue_init(&seg->hlist);
+            seg->bounds.minv = seg->bounds.maxv = 0;
+        }
+        kept++;
+    }
+    ns->nr_segs = kept;
+    ns->nr_segs_waiting = waiting;
+    ACCESS_ONCE(ns->segs_held) = kept != waiting;
+    return max_version;
+}
+
+static bool lrcu_worker_has_work(struct lrcu_handler *h){
+    size_t i;
+
+    for(i = 0; i < LRCU_NS_MAX; i++){
+        struct lrcu_namespace *ns = h->worker_ns[i];
+
+        if(ns == NULL)
+            continue;
+        if(lrcu_ns_has_calls(ns))
+            return true;
+        /* hazard held leftovers wait for lrcu_hazard_release_ns() */
+        if(!lrcu_queue_empty(&ns->free_list) ||
+                    !lrcu_queue_empty(&ns->free_hlist) || ns->nr_segs_waiting)
+            return true;
+        /* pending removal */
+        if(ns != h->ns[i])
+            return true;
+        if(lrcu_gp_requested(ns))
+            return true;
+    }
+    return false;
+}
+
+/* seq - worker_wake at the beginning of the pass. see lrcu_worker_wake */
+static void lrcu_worker_park(struct lrcu_handler *h, u32 seq){
+    h->worker_parked = true;
+    mb();
+    if(!lrcu_worker_has_work(h) && h->worker_state != LRCU_WORKER_STOP)
+        LRCU_FUTEX_WAIT(&h->worker_wake, seq, LRCU_WORKER_PARK_US);
+    h->worker_parked = false;
+}
+
+static inline void *lrcu_worker(void *arg){
+    struct lrcu_handler *h = (struct lrcu_handler *)arg;
+    lrcu_range_t ranges[LRCU_THREADS_MAX];
+    void **hazards = NULL; /* see lrcu_hazards_grow */
+    size_t hz_max = 0;
+    u32 timeout = h->worker_timeout;
+
+    /*
+        pointer to ti, so that any ns when added threads, 
+        added this one too. this allows to use any ns in destructors
+    */
+    h->worker_ti = __lrcu_thread_init();
+    LRCU_ASSERT(h->worker_ti);
+
+    h->worker_state = LRCU_WORKER_RUNNING;
+    /* let initializing thread see that we changed state */
+    wmb();
+
+    while(h->worker_state != LRCU_WORKER_STOP && !LRCU_THREAD_SHOULD_STOP()){
+        u32 seq = ACCESS_ONCE(h->worker_wake);
+        bool pending = false;
+        size_t freed = 0;
+        size_t i;
+
+        rmb(); /* seq first, then lists */
+        for(i = 0; i < LRCU_NS_MAX; i++){
+            struct lrcu_namespace *ns = h->worker_ns[i];
+            struct lrcu_call_bounds batch = { 0, 0 };
+            u64 spliced_version, gp_completed;
+            size_t ns_freed = freed;
+            bool ns_pending = false;
+            bool harvested;
+
+            if(ns == NULL){
+                lrcu_read_cache_clear(i); /* in case destructors used it */
+                continue;
+            }
+            lrcu_read_cache_check(ns);
+            gp_completed = ns->gp_completed;
+
+            spliced_version = ACCESS_ONCE(ns->version);
+            mb(); /* version first, then call queues. see lrcu_ns_harvest */
+            harvested = lrcu_ns_harvest(ns, &batch);
+#ifdef LRCU_LIST_ATOMIC
+            /* XXX callback could still be added later with older version */
+            if(!lrcu_queue_empty(&ns->free_list) ||
+                        !lrcu_queue_empty(&ns->free_hlist)){
+                lrcu_queue_splice_atomic(&ns->worker_list, &ns->free_list.lh);
+                lrcu_queue_splice_atomic(&ns->worker_hlist, &ns->free_hlist.lh);
+                /* no bounds for lock-free lists, take everything so far */
+                lrcu_call_bounds_add(&batch, 1);
+                lrcu_call_bounds_add(&batch, ACCESS_ONCE(ns->version));
+            }
+#else
+            /*
+                Callbacks read version under list locks, so every callback
+                left behind in free lists has spliced_version or newer one.
+                Locks are taken even on empty lists for the same reason.
+            */
+            lrcu_spin_lock(&ns->list_lock);
+            lrcu_queue_splice(&ns->worker_list, &ns->free_list);
+            lrcu_call_bounds_take(&batch, &ns->free_bounds);
+            lrcu_spin_unlock(&ns->list_lock);
+
+            lrcu_spin_lock(&ns->list_hlock);
+            lrcu_queue_splice(&ns->worker_hlist, &ns->free_hlist);
+            lrcu_call_bounds_take(&batch, &ns->free_hbounds);
+            lrcu_spin_unlock(&ns->list_hlock);
+#endif
+            lrcu_ns_segment_push(ns, &batch);
+            if(ns->nr_segs){
+                lrcu_rangetree_t rbt = RANGE_BINTREE_INIT(ranges, LRCU_THREADS_MAX);
+                size_t hz_len = 0;
+                lrcu_queue_head_t recycled = { { NULL }, NULL };
+                u64 waiting;
+
+                lrcu_gp_completed_update(ns, &rbt,
+                                    __lrcu_get_synchronized(ns, &rbt));
+                /* opt-in. namespaces without hazards do not pay for it */
+                if(ns->hazards){
+                    hazards = lrcu_hazards_grow(hazards, &hz_max,
+                                            ACCESS_ONCE(ns->nr_threads));
+                    hz_len = __lrcu_get_hazards(ns, hazards, hz_max);
+                }
+
+                waiting = lrcu_ns_segments_run(ns, &rbt, hazards, hz_len,
+                                hz_max, &recycled, &freed, spliced_version);
+                /* before processed_version, lrcu_barrier() callers reuse them */
+                lrcu_call_pool_put(h, &recycled);
+                /* barrier for processed version write */
+                wmb();
+                /*
+                    every callback below lowest waiting segment has been called.
+                    release lrcu_barrier. callbacks added after splice are not,
+                    so no further than spliced_version
+                */
+                if(harvested)
+                    ns->processed_version = waiting;
+            }else if(lrcu_gp_requested(ns)){
+                /* no callbacks, but lrcu_poll_state_ns() waits for grace period */
+                lrcu_rangetree_t rbt = RANGE_BINTREE_INIT(ranges, LRCU_THREADS_MAX);
+
+                lrcu_gp_completed_update(ns, &rbt,
+                                    __lrcu_get_synchronized(ns, &rbt));
+            }
+            /* make sure we see both ns[] and worker_ns[] */
+            rmb();
+            /*  h->worker_ns[i] and h->ns[i] could be different values,
+                that means ns is freed. our action is to wait for all threads
+                either to suspend, or enter and leave lrcu_read section, so
+                that we definately know that thread does not have released ns
+                The main problem is when thread dereferences h->ns[i],
+                he could be rescheduled for undetermined amount of time,
+                meanwhile ns destructor could be called, but when that thread
+                wakes up, it would access freed memory. This means, that any
+                thread could not be trusted to not have pointer to freeing ns,
+                until it reaches some state, that would indicate 100% it passing
+                that section of code, e.g. (thread_info->lns[i]->version >= ns->version)
+            */
+            if(unlikely(ns->nr_segs == 0 && h->worker_ns[i] != h->ns[i])){
+                lrcu_spin_lock(&h->ns_lock);
+                /* check again under spinlock */
+                if(likely(h->worker_ns[i] != h->ns[i]
+                        && lrcu_queue_empty(&ns->free_list)
+                        && lrcu_queue_empty(&ns->free_hlist)
+                        && lrcu_ns_destructor(h->worker_ns[i], false))){
+                    h->worker_ns[i] = NULL;
+                    lrcu_spin_unlock(&h->ns_lock);
+                    continue;
+                }
+                lrcu_spin_unlock(&h->ns_lock);
+            }
+
+            if(!harvested)
+                ns_pending = true;
+            else if(ns->nr_segs == 0)
+                ns->processed_version = spliced_version;
+            else if(ns->nr_segs_waiting)
+                ns_pending = true;
+            if(lrcu_gp_requested(ns))
+                ns_pending = true;
+            /*
+                Something waits for readers: start next grace period, so
+                that new readers do not hold it. Removal waits for threads
+                to pass new version too. Idle namespace keeps its version.
+            */
+            if(ns_pending || h->worker_ns[i] != h->ns[i])
+                lrcu_version_advance(ns, spliced_version);
+            pending |= ns_pending;
+            /* lrcu_barrier waits for processed_version */
+            mb();
+            if(ACCESS_ONCE(ns->sync_wait.armed))
+                __lrcu_sync_wake(&ns->sync_wait);
+            /* event loops poll or check their async callbacks */
+            if(ns->eventfd >= 0 && (freed != ns_freed ||
+                            ACCESS_ONCE(ns->gp_completed) != gp_completed))
+                LRCU_EVENTFD_SIGNAL(ns->eventfd);
+        }
+        if(pending){
+            /* callbacks wait for readers. back off while nothing is freed */
+            if(freed)
+                timeout = h->worker_timeout;
+            else if(timeout < LRCU_WORKER_SLEEP_MAX_US)
+                timeout *= 2;
+            LRCU_USLEEP(timeout);
+        }else{
+            timeout = h->worker_timeout;
+            lrcu_worker_park(h, seq);
+        }
+    }
+    LRCU_FREE(hazards);
+    lrcu_thread_deinit();
+    h->worker_state = LRCU_WORKER_DONE;
+    return NULL;
+}
+
+/***********************************************************/
+
+/*
+    Online QSBR thread would wait for itself. It does not hold pointers
+    while waiting, so put it offline for that time.
+*/
+static bool lrcu_wait_begin(struct lrcu_thread_info *ti,
+                                struct lrcu_namespace *ns){
+    bool qsbr_online = false;
+
+    if(ti == NULL)
+        return false;
+
+    if(ns->flavor == LRCU_FLAVOR_QSBR && LRCU_GET_LNS(ti, ns)->counter){
+        lrcu_thread_offline_ns(ns->id);
+        qsbr_online = true;
+    }
+    LRCU_ASSERT(LRCU_GET_LNS(ti, ns)->counter == 0);
+    return qsbr_online;
+}
+
+static void lrcu_wait_end(struct lrcu_namespace *ns, bool qsbr_online){
+    if(qsbr_online)
+        lrcu_thread_online_ns(ns->id);
+}
+
+void lrcu_synchronize_ns(u8 ns_id){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    lrcu_range_t ranges[LRCU_THREADS_MAX];
+    u64 current_version;
+    bool qsbr_online;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    qsbr_online = lrcu_wait_begin(ti, ns);
+
+    current_version = ns->version;
+    rmb();
+    /* readers from now on are newer */
+    lrcu_version_advance(ns, current_version);
+    lrcu_worker_wake(h, false);
+    /*
+        Concurrent callers share scans: one holding sync_lock scans for
+        everybody and moves gp_completed, the rest sleep and check it.
+        Any scan started after our version bump is good for us.
+        No timeout: we wait as long as an older reader stays in section.
+    */
+    while(1){
+        lrcu_rangetree_t rbt = RANGE_BINTREE_INIT(ranges, LRCU_THREADS_MAX);
+        u32 seq = lrcu_sync_wait_arm(ns, current_version);
+        u64 completed;
+
+        completed = ACCESS_ONCE(ns->gp_completed);
+        if(current_version < completed)
+            break;
+        if(lrcu_spin_trylock(&ns->sync_lock)){
+            /* busy. scanner wakes us when it gets further */
+            lrcu_sync_wait_sleep(ns, seq);
+            continue;
+        }
+        lrcu_gp_completed_update(ns, &rbt,
+                            __lrcu_get_synchronized(ns, &rbt));
+        lrcu_spin_unlock(&ns->sync_lock);
+
+        if(ACCESS_ONCE(ns->gp_completed) != completed){
+            /* older waiters could be done. we rescan instead of sleeping */
+            if(ACCESS_ONCE(ns->sync_wait.armed))
+                __lrcu_sync_wake(&ns->sync_wait);
+            continue;
+        }
+        /* gp_completed stays behind hung threads, own scan does not */
+        if(!lrcu_rangetree_find(&rbt, current_version))
+            break;
+        lrcu_sync_wait_sleep(ns, seq);
+    }
+    /* pairs with readers' section end, seen through the scan */
+    mb();
+    lrcu_wait_end(ns, qsbr_online);
+}
+LRCU_EXPORT_SYMBOL(lrcu_synchronize_ns);
+
+/*
+    Snapshot threads in section with current_version or older and spin
+    until each leaves it or moves to newer version. threads_lock is held
+    for the snapshot only. Leaves live as long as the namespace, so slot
+    stays readable after its thread goes, and thread taking the slot
+    reads its version after our bump. Snapshot buffer is the namespace's,
+    under sync_lock, and grows with nr_threads.
+    Returns false if snapshot did not fit or spins ran out.
+*/
+static bool lrcu_synchronize_spin(struct lrcu_namespace *ns,
+                                                u64 current_version){
+    struct lrcu_local_namespace **snap;
+    u32 nr_threads = ACCESS_ONCE(ns->nr_threads);
+    size_t len = 0, i;
+    u32 spins, l, b;
+    u64 bits;
+
+    if(nr_threads > ns->spin_snap_max){
+        snap = LRCU_CALLOC(nr_threads, sizeof(*snap));
+        if(snap){
+            LRCU_FREE(ns->spin_snap);
+            ns->spin_snap = snap;
+            ns->spin_snap_max = nr_threads;
+        }
+    }
+    snap = ns->spin_snap;
+
+    if(ns->flavor == LRCU_FLAVOR_MEMBARRIER)
+        LRCU_MEMBARRIER();
+
+    lrcu_spin_lock(&ns->threads_lock);
+    for(l = 0; l < ns->nr_leaves; l++){
+        lrcu_leaf_for_each_slot(ns->leaves[l], bits, b){
+            struct lrcu_local_namespace *lns = &ns->leaves[l]->slots[b].lns;
+
+            if(ACCESS_ONCE(lns->counter) == 0 ||
+                        ACCESS_ONCE(lns->version) > current_version)
+                continue;
+            if(len == ns->spin_snap_max){
+                /* threads added since we looked, or no memory */
+                lrcu_spin_unlock(&ns->threads_lock);
+                return false;
+            }
+            snap[len++] = lns;
+        }
+    }
+    lrcu_spin_unlock(&ns->threads_lock);
+
+    for(spins = 0; len && spins < LRCU_EXPEDITED_SPINS; spins++){
+        for(i = 0; i < len; ){
+            if(ACCESS_ONCE(snap[i]->counter) == 0 ||
+                        ACCESS_ONCE(snap[i]->version) > current_version)
+                snap[i] = snap[--len];
+            else
+                i++;
+        }
+        cpu_relax();
+    }
+    return len == 0;
+}
+
+void lrcu_synchronize_expedited_ns(u8 ns_id){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    u64 current_version;
+    bool qsbr_online, done;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    if(LRCU_FLAVOR_IS_PERCPU(ns->flavor)){
+        lrcu_synchronize_ns(ns_id);
+        return;
+    }
+
+    qsbr_online = lrcu_wait_begin(ti, ns);
+    current_version = ns->version;
+    rmb();
+    lrcu_version_advance(ns, current_version);
+
+    /* one spinner at a time, the rest wait for it in lrcu_synchronize_ns */
+    done = false;
+    if(!lrcu_spin_trylock(&ns->sync_lock)){
+        done = lrcu_synchronize_spin(ns, current_version);
+        lrcu_spin_unlock(&ns->sync_lock);
+    }
+    if(done){
+        /* reads of readers we saw leaving happen before our frees */
+        if(ns->flavor == LRCU_FLAVOR_MEMBARRIER)
+            LRCU_MEMBARRIER();
+        else
+            mb();
+        lrcu_gp_completed_advance(ns, current_version + 1);
+        if(ACCESS_ONCE(ns->sync_wait.armed))
+            __lrcu_sync_wake(&ns->sync_wait);
+    }
+    lrcu_wait_end(ns, qsbr_online);
+
+    if(!done)
+        lrcu_synchronize_ns(ns_id);
+}
+LRCU_EXPORT_SYMBOL(lrcu_synchronize_expedited_ns);
+
+/***********************************************************/
+
+void lrcu_barrier_ns(u8 ns_id){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    u64 current_version;
+    bool qsbr_online;
+
+    lrcu_synchronize_ns(ns_id);
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    qsbr_online = lrcu_wait_begin(ti, ns);
+
+    current_version = ns->version;
+    /* worker's next pass reports processed_version past current_version */
+    lrcu_version_advance(ns, current_version);
+    lrcu_worker_wake(h, true);
+    /* until every callback older than current_version ran, no timeout */
+    while(1){
+        /* version 0, only the worker wakes us */
+        u32 seq = lrcu_sync_wait_arm(ns, 0);
+
+        if(current_version < ns->processed_version)
+            break;
+        lrcu_sync_wait_sleep(ns, seq);
+    }
+    lrcu_wait_end(ns, qsbr_online);
+}
+LRCU_EXPORT_SYMBOL(lrcu_barrier_ns);
+
+/***********************************************************/
+
+/*
+    Cookie is namespace version. Objects unpublished before the call are
+    seen only by readers with this version or older. Version is moved on,
+    so readers starting after the call do not keep the cookie waiting.
+*/
+u64 lrcu_get_state_ns(u8 ns_id){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    u64 cookie;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    cookie = ns->version;
+    rmb();
+    lrcu_version_advance(ns, cookie);
+    return cookie;
+}
+LRCU_EXPORT_SYMBOL(lrcu_get_state_ns);
+
+bool lrcu_poll_state_ns(u8 ns_id, u64 cookie){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    u64 old;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    if(cookie < ACCESS_ONCE(ns->gp_completed)){
+        /* no reads of the object after this */
+        mb();
+        return true;
+    }
+
+    /* ask the worker to scan even without callbacks */
+    while((old = ACCESS_ONCE(ns->gp_requested)) < cookie){
+        if(lrcu_cmpxchg(&ns->gp_requested, old, cookie) == old)
+            break;
+    }
+    lrcu_worker_wake(h, true);
+    return false;
+}
+LRCU_EXPORT_SYMBOL(lrcu_poll_state_ns);
+
+void lrcu_cond_synchronize_ns(u8 ns_id, u64 cookie){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    if(cookie < ACCESS_ONCE(ns->gp_completed)){
+        mb();
+        return;
+    }
+    /* waits for current version, which is not older than cookie */
+    lrcu_synchronize_ns(ns_id);
+}
+LRCU_EXPORT_SYMBOL(lrcu_cond_synchronize_ns);
+
+/***********************************************************/
+
+void lrcu_synchronize_async_ns(u8 ns_id, lrcu_destructor_t *cb, void *arg){
+    /* callback's version is the current one, same as synchronize waits for */
+    lrcu_call_ns(ns_id, arg, cb);
+}
+LRCU_EXPORT_SYMBOL(lrcu_synchronize_async_ns);
+
+int lrcu_ns_eventfd(u8 ns_id){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    int fd;
+
+    LRCU_ASSERT(h);
+
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+
+    fd = ACCESS_ONCE(ns->eventfd);
+    if(fd >= 0)
+        return fd;
+
+    fd = LRCU_EVENTFD_CREATE();
+    if(fd < 0)
+        return -1;
+    /* lost the race, use the other one */
+    if(lrcu_cmpxchg(&ns->eventfd, -1, fd) != -1){
+        LRCU_EVENTFD_CLOSE(fd);
+        fd = ns->eventfd;
+    }
+    return fd;
+}
+LRCU_EXPORT_SYMBOL(lrcu_ns_eventfd);
+
+/***********************************************************/
+
+/* TODO make it constructor/destructor */
+struct lrcu_handler *lrcu_init(void){
+    struct lrcu_handler *h = __lrcu_init();
+
+    LRCU_ASSERT(h);
+    if(lrcu_ns_init(LRCU_NS_DEFAULT))
+        return h;
+
+    /* failed */
+    lrcu_deinit();
+    return NULL;
+}
+LRCU_EXPORT_SYMBOL(lrcu_init);
+
+struct lrcu_handler *__lrcu_init(void){
+    struct lrcu_handler *h;
+
+    LRCU_TLS_INIT(__lrcu_thread_info);
+
+    h = LRCU_CALLOC(1, sizeof(struct lrcu_handler));
+    if(h == NULL)
+        return NULL;
+
+    h->worker_state = LRCU_WORKER_RUN;
+    /* protect worker_state reads and writes here and in worker */
+    mb();
+
+    h->worker_timeout = LRCU_WORKER_SLEEP_US;
+    LRCU_SET_HANDLER(h);
+
+    if(LRCU_THREAD_CREATE(&h->worker_tid, lrcu_worker, (void *)h))
+        goto out;
+
+    barrier();
+    /* wait for worker thread to start */
+    while(h->worker_state == LRCU_WORKER_RUN)
+        LRCU_USLEEP(1);
+
+    /* worker_state */
+    mb();
+
+    if(h->worker_state != LRCU_WORKER_RUNNING)
+        goto out;
+
+    return h;
+out:
+    LRCU_DEL_HANDLER();
+    LRCU_FREE(h);
+    LRCU_TLS_DEINIT(__lrcu_thread_info);
+    return NULL;
+}
+LRCU_EXPORT_SYMBOL(__lrcu_init);
+
+/*
+    Queued records live in pool chunks. Worker is gone, nobody runs them
+    any more, so every list that can point into chunks is emptied before
+    chunks are freed. hlists hold heads in caller's objects, they stay.
+*/
+static void lrcu_call_records_forget(struct lrcu_handler *h){
+    struct lrcu_thread_info *ti;
+    u64 bits;
+    u32 i, l;
+
+    for(i = 0; i < LRCU_NS_MAX; i++){
+        struct lrcu_namespace *nss[2] = { h->ns[i], h->worker_ns[i] };
+        u32 k;
+
+        for(k = 0; k < 2; k++){
+            struct lrcu_namespace *ns = nss[k];
+
+            if(ns == NULL || (k == 1 && ns == nss[0]))
+                continue;
+            lrcu_spin_lock(&ns->threads_lock);
+            for(l = 0; l < ns->nr_leaves; l++){
+                lrcu_leaf_for_each(ns->leaves[l], bits, ti){
+                    ti->cache.head = NULL;
+                    ti->cache.len = 0;
+                    lrcu_queue_init(&ti->calls[ns->id].list);
+                }
+            }
+            lrcu_spin_unlock(&ns->threads_lock);
+            lrcu_queue_init(&ns->free_list);
+            lrcu_queue_init(&ns->worker_list);
+            for(l = 0; l < ns->nr_segs; l++)
+                lrcu_queue_init(&ns->segs[l].list);
+        }
+    }
+    lrcu_queue_init(&h->pool);
+}
+
+void lrcu_deinit(void){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_thread_info *ti;
+
+    LRCU_ASSERT(h);
+
+    /* unsafe */
+    //lrcu_ns_deinit(LRCU_NS_DEFAULT); TODO
+
+    h->worker_state = LRCU_WORKER_STOP;
+    lrcu_worker_wake(h, true);
+
+    LRCU_THREAD_JOIN(&h->worker_tid);
+    LRCU_DEL_HANDLER();
+
+    /* records of our cache are in chunks too, even if we left every ns */
+    ti = LRCU_GET_TI();
+    if(ti){
+        ti->cache.head = NULL;
+        ti->cache.len = 0;
+    }
+    lrcu_call_records_forget(h);
+    while(h->pool_chunks){
+        struct lrcu_call_chunk *chunk = h->pool_chunks;
+
+        h->pool_chunks = chunk->next;
+        LRCU_FREE(chunk);
+    }
+
+    LRCU_TLS_DEINIT(__lrcu_thread_info);
+    /* TODO remove all ns and do something with all ptrs? */
+}
+LRCU_EXPORT_SYMBOL(lrcu_deinit);
+
+/***********************************************************/
+
+struct lrcu_namespace *lrcu_ns_init(u8 id){
+    return lrcu_ns_init_flavor(id, LRCU_FLAVOR_FENCE);
+}
+LRCU_EXPORT_SYMBOL(lrcu_ns_init);
+
+struct lrcu_namespace *lrcu_ns_init_flavor(u8 id, int flavor){
+    struct lrcu_namespace *ns = NULL;
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+
+    LRCU_ASSERT(h);
+    LRCU_ASSERT(flavor >= 0 && flavor < LRCU_FLAVOR_MAX);
+
+    if(flavor == LRCU_FLAVOR_MEMBARRIER && !LRCU_MEMBARRIER_REGISTER()){
+        LRCU_LOG("lrcu: membarrier unavailable, ns %u uses fences\n", id);
+        flavor = LRCU_FLAVOR_FENCE;
+    }
+
+    /* schedule lrcu_thread_set_ns to worker */
+
+    lrcu_spin_lock(&h->ns_lock);
+    LRCU_ASSERT(!h->ns[id]);
+    LRCU_ASSERT(h->worker_ti);
+
+    if(h->worker_ns[id] != NULL){
+        struct lrcu_leaf *leaf;
+        /* alraedy allocated, but pending removal. nothing to do */
+        ns = h->worker_ns[id];
+        leaf = lrcu_ns_thread_leaf(ns, h->worker_ti);
+        LRCU_ASSERT(leaf);
+        /* how can this be? when removing, we should take lock */
+        if(leaf == NULL){
+            /* no need to take threads_lock since we are not working ns */
+            if (!lrcu_ns_thread_add(ns, h->worker_ti)){
+                lrcu_spin_unlock(&h->ns_lock);
+                return NULL;
+            }
+        }
+        /* pending removal ns keeps its counters, so keep the flavor */
+        if(ns->flavor != flavor)
+            LRCU_WARN("lrcu: ns %u reused with flavor %d\n", id, ns->flavor);
+        /* make sure we add first, only then recreate ns. XXX maybe wmb()? */
+        barrier();
+        h->ns[id] = ns;
+        lrcu_spin_unlock(&h->ns_lock);
+        return ns;
+    }
+
+    ns = LRCU_CALLOC(1, sizeof(struct lrcu_namespace));
+    if(ns == NULL)
+        goto out;
+
+    ns->id = id;
+    ns->flavor = flavor;
+#ifdef LRCU_READ_INLINE
+    ns->gen = ACCESS_ONCE(__lrcu_ns_gen[id]);
+#endif
+    ns->version = 1;
+    ns->gp_completed = 1;
+    ns->eventfd = -1;
+    ns->sync_timeout = LRCU_NS_SYNC_SLEEP_US;
+    if(LRCU_FLAVOR_IS_PERCPU(flavor)){
+        ns->nr_cpus = LRCU_NR_CPUS();
+        if(ns->nr_cpus == 0)
+            ns->nr_cpus = 1;
+        ns->pcpu = LRCU_CALLOC(ns->nr_cpus, sizeof(struct lrcu_percpu_counter));
+        if(ns->pcpu == NULL){
+            LRCU_FREE(ns);
+            ns = NULL;
+            goto out;
+        }
+    }
+    /* no need to take a lock */
+    if (!lrcu_ns_thread_add(ns, h->worker_ti)){
+        LRCU_FREE(ns->pcpu);
+        LRCU_FREE(ns);
+        ns = NULL;
+        goto out;
+    }
+    /* first allocate and init, then assign */
+    wmb();
+    h->ns[id] = ns;
+    h->worker_ns[id] = ns;
+    wmb(); /* make sure they are seen both. have rmb() on read side */
+
+out:
+    lrcu_spin_unlock(&h->ns_lock);
+    return ns;
+}
+LRCU_EXPORT_SYMBOL(lrcu_ns_init_flavor);
+
+void lrcu_ns_deinit_safe(u8 id){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    
+    LRCU_ASSERT(h);
+
+    lrcu_spin_lock(&h->ns_lock);
+    ns = h->ns[id];
+    LRCU_ASSERT(ns);
+
+    lrcu_write_barrier_ns(id); /* bump version, needs h->ns[id] */
+    h->ns[id] = NULL;
+    /* all threads shall see this pointer now */
+    wmb();
+    lrcu_spin_unlock(&h->ns_lock);
+    lrcu_worker_wake(h, true); /* worker destroys it */
+}
+LRCU_EXPORT_SYMBOL(lrcu_ns_deinit_safe);
+
+void lrcu_ns_deinit(u8 id){
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+
+    LRCU_ASSERT(h);
+
+    lrcu_spin_lock(&h->ns_lock);
+    ns = h->ns[id];
+    LRCU_ASSERT(ns);
+
+    lrcu_write_barrier_ns(id); /* bump version */
+    lrcu_barrier_ns(id); /* wait for all callbacks to execute */
+    h->ns[id] = NULL;
+    /* all threads shall see this pointer now */
+    wmb();
+
+    lrcu_ns_destructor(h->worker_ns[id], true);
+    barrier();
+    h->worker_ns[id] = NULL;
+
+    lrcu_spin_unlock(&h->ns_lock);
+}
+LRCU_EXPORT_SYMBOL(lrcu_ns_deinit);
+
+struct lrcu_thread_info *lrcu_thread_init(void){
+    struct lrcu_thread_info *ti = __lrcu_thread_init();
+
+    LRCU_ASSERT(ti);
+
+    if(!lrcu_thread_set_ns(LRCU_NS_DEFAULT)){
+        lrcu_thread_deinit();
+        return NULL;
+    }
+
+    return ti;
+}
+LRCU_EXPORT_SYMBOL(lrcu_thread_init);
+
+struct lrcu_thread_info *__lrcu_thread_init(void){
+    struct lrcu_thread_info *ti = NULL;
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+
+    LRCU_ASSERT(h);
+
+    ti = LRCU_CALLOC(1, sizeof(struct lrcu_thread_info));
+    if(ti == NULL)
+        return NULL;
+
+    lrcu_thread_info_init(ti, h);
+    LRCU_SET_TI(ti);
+
+    return ti;
+}
+LRCU_EXPORT_SYMBOL(__lrcu_thread_init);
+
+bool lrcu_thread_set_ns(u8 ns_id){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    struct lrcu_handler *h = LRCU_GET_HANDLER();
+    struct lrcu_namespace *ns;
+    bool ret;
+
+    LRCU_ASSERT(h);
+    LRCU_ASSERT(ti);
+
+    lrcu_spin_lock(&h->ns_lock);
+    ns = h->ns[ns_id];
+    LRCU_ASSERT(ns);
+    lrcu_spin_unlock(&h->ns_lock);
+
+    /* locking in spinlock. careful of deadlock */
+    if(ns->flavor == LRCU_FLAVOR_QSBR){
+        /* threads start online */
+        LRCU_GET_LNS(ti, ns)->counter = 1;
+        LRCU_GET_LNS(ti, ns)->version = ns->version;
+        wmb();
+    }
+
+    lrcu_spin_lock(&ns->threads_lock);
+    ret = lrcu_ns_thread_add(ns, ti);
+    lrcu_spin_unlock(&ns->threads_lock);
+
+    if(ret)
+        lrcu_read_cache_set(ti, ns);
+    return ret;
+}
+LRCU_EXPORT_SYMBOL(lrcu_thread_set_ns);
+
+/* assume ns lock taken and ti and ti->h non-null */
+static bool thread_remove_from_ns(struct lrcu_thread_info *ti, u8 ns_id){
+    struct lrcu_namespace *ns = ti->h->worker_ns[ns_id];
+    bool found;
+
+    LRCU_ASSERT(ns);
+
+    /* always called from the thread itself, so tls is ours */
+    lrcu_read_cache_clear(ns_id);
+
+    lrcu_spin_lock(&ns->threads_lock); /* locking in spinlock. careful of deadlock */
+    found = lrcu_ns_thread_del(ns, ti);
+    if(ns->flavor == LRCU_FLAVOR_QSBR)
+        LRCU_GET_LNS(ti, ns)->counter = 0; /* offline */
+    lrcu_spin_unlock(&ns->threads_lock);
+    if(!found){
+        /* failed to set thread's ns, then exited thread. */
+    }
+    return found;
+}
+
+bool lrcu_thread_del_ns(u8 ns_id){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    bool ret;
+
+    LRCU_ASSERT(ti);
+    LRCU_ASSERT(ti->h);
+
+    lrcu_spin_lock(&ti->h->ns_lock);
+    ret = thread_remove_from_ns(ti, ns_id);
+    lrcu_spin_unlock(&ti->h->ns_lock);
+
+    return ret;
+}
+LRCU_EXPORT_SYMBOL(lrcu_thread_del_ns);
+
+static void thread_destructor_callback(struct lrcu_thread_info *ti){
+    struct lrcu_handler *h = ti->h;
+    int found = false;
+    int i;
+
+    LRCU_ASSERT(ti);
+    LRCU_ASSERT(h);
+
+    lrcu_spin_lock(&h->ns_lock);
+    for(i = 0; i < LRCU_NS_MAX; i++){
+        found = found || thread_remove_from_ns(ti, i);
+    }
+    lrcu_spin_unlock(&h->ns_lock);
+    lrcu_call_cache_drain(h, &ti->cache);
+    if(!found){
+        /* failed to set thread's ns, then exited thread. */
+    }
+    LRCU_FREE(ti);
+}
+
+#if 0
+void lrcu_thread_deinit(void){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+    if(ti == NULL)
+        return;
+
+    /* remove from all namespaces */
+    __lrcu_call_ns(LRCU_NS_DEFAULT, (void *)ti, (lrcu_destructor_t *)thread_destructor_callback);
+    LRCU_DEL_TI(ti);
+    /* wait for it to process, since TLS gets deleted with the thread */
+    lrcu_barrier_ns(LRCU_NS_DEFAULT);
+}
+#endif
+
+void lrcu_thread_deinit(void){
+    struct lrcu_thread_info *ti = LRCU_GET_TI();
+
+    LRCU_ASSERT(ti);
+
+    if(ti)
+        thread_destructor_callback(ti);
+    LRCU_DEL_TI(ti);
+}
+LRCU_EXPORT_SYMBOL(lrcu_thread_deinit);
+
+/* already allocated ptr */
+void lrcu_ptr_init(struct lrcu_ptr *ptr, u8 ns_id, 
+                                lrcu_destructor_t *deinit){
+    ptr->ns_id = ns_id;
+    ptr->deinit = deinit;
+    ptr->ptr = NULL;
+}
+LRCU_EXPORT_SYMBOL(lrcu_ptr_init);
+
+/* getters for private fields */
+struct lrcu_namespace *lrcu_ti_get_ns(struct lrcu_thread_info *ti, u8 id){
+    LRCU_ASSERT(ti);
+    LRCU_ASSERT(ti->h);
+    return ti->h->ns[id];
+}
+
+struct lrcu_namespace *lrcu_get_ns(struct lrcu_handler *h, u8 id){
+    LRCU_ASSERT(h);
+    return h->ns[id];
+}
+
+LRCU_OS_API_DEFINE
@@ -1,73 +1,227 @@
-#ifndef _LRCU_INTERNAL_H
-#define _LRCU_INTERNAL_H
-
-#include <lrcu/lrcu.h>
-#include "spinlock.h"
-
-#include <lrcu/list.h>
-#include <lrcu/atomics.h>
-#include <lrcu/compiler.h>
-
-enum{ /* thread worker states */
-    LRCU_WORKER_READY = 0,
-    LRCU_WORKER_RUN,
-    LRCU_WORKER_RUNNING,
-    LRCU_WORKER_STOP,
-    LRCU_WORKER_DONE,
-};
-
-struct lrcu_handler{
-    lrcu_spinlock_t  ns_lock;
-    struct lrcu_namespace *ns[LRCU_NS_MAX];
-    struct lrcu_namespace *worker_ns[LRCU_NS_MAX]; 
-    /* duplicated set of pointers. used to properly remove namespaces */
-
-    struct lrcu_thread_info *worker_ti;
-    LRCU_THREAD_T worker_tid;
-    int worker_state;
-    u32 worker_timeout;
-};
-
-struct lrcu_namespace {
-    lrcu_spinlock_t  write_lock;
-    u64 processed_version;
-    u32 sync_timeout;
-    lrcu_spinlock_t  threads_lock;
-    lrcu_list_head_t threads;
-    lrcu_list_head_t hung_threads;
-    u8 id;
-
-    lrcu_spinlock_t  list_hlock;
-    lrcu_list_head_t free_hlist, worker_hlist;
-
-    lrcu_spinlock_t  list_lock;
-    lrcu_list_head_t free_list, worker_list;
-    u64 version LRCU_ALIGNED;
-} LRCU_ALIGNED;
-
-typedef struct lrcu_local_namespace {
-    u64 version;
-    i32 counter; /* max nesting depth 2^32 */
-} lrcu_local_namespace_t;
-
-/* XXX make number of namespaces dynamic??? */
-struct lrcu_thread_info{
-    struct lrcu_handler *h;
-    LRCU_TIMER_TYPE timeval[LRCU_NS_MAX];
-    struct lrcu_local_namespace lns[LRCU_NS_MAX];
-    struct lrcu_local_namespace hung_lns[LRCU_NS_MAX];
-};
-
-#define LRCU_GET_LNS_ID(ti, ns_id) (&(ti)->lns[(ns_id)])
-#define LRCU_GET_LNS(ti, ns) LRCU_GET_LNS_ID((ti), (ns)->id)
-#define LRCU_GET_HUNG_LNS(ti, ns) (&(ti)->hung_lns[(ns)->id])
-
-#define LRCU_GET_HANDLER() (__lrcu_handler)
-#define LRCU_SET_HANDLER(x) __lrcu_handler = (x)
-#define LRCU_DEL_HANDLER() __lrcu_handler = NULL
-
-#define LRCU_GET_TI() LRCU_TLS_GET(__lrcu_thread_info)
-#define LRCU_SET_TI(x) LRCU_TLS_SET(__lrcu_thread_info, (x))
-#define LRCU_DEL_TI(x) LRCU_TLS_SET(__lrcu_thread_info, NULL)
-
+#ifndef _LRCU_INTERNAL_H
+#define _LRCU_INTERNAL_H
+
+#include <lrcu/lrcu.h>
+#include "spinlock.h"
+
+#include <lrcu/list.h>
+#include <lrcu/atomics.h>
+#include <lrcu/compiler.h>
+
+enum{ /* thread worker states */
+    LRCU_WORKER_READY = 0,
+    LRCU_WORKER_RUN,
+    LRCU_WORKER_RUNNING,
+    LRCU_WORKER_STOP,
+    LRCU_WORKER_DONE,
+};
+
+struct lrcu_handler{
+    lrcu_spinlock_t  ns_lock;
+    struct lrcu_namespace *ns[LRCU_NS_MAX];
+    struct lrcu_namespace *worker_ns[LRCU_NS_MAX]; 
+    /* duplicated set of pointers. used to properly remove namespaces */
+
+    struct lrcu_thread_info *worker_ti;
+    LRCU_THREAD_T worker_tid;
+    int worker_state;
+    u32 worker_timeout;
+    /* futex word. bumped to make parked worker do one more pass */
+    u32 worker_wake;
+    bool worker_parked;
+
+    /* free callback records. see lrcu_call_record_get */
+    lrcu_spinlock_t pool_lock;
+    lrcu_queue_head_t pool;
+    struct lrcu_call_chunk *pool_chunks; /* freed by lrcu_deinit() */
+};
+
+/* flavors counting readers in per-cpu counters instead of thread scan */
+#define LRCU_FLAVOR_IS_PERCPU(f) \
+        ((f) == LRCU_FLAVOR_PERCPU || (f) == LRCU_FLAVOR_SLEEPABLE)
+
+/* LRCU_FLAVOR_PERCPU. two epochs, readers count in current one */
+struct lrcu_percpu_counter {
+    u64 lock[2];
+    u64 unlock[2];
+} LRCU_ALIGNED;
+
+/*
+    Registered threads of a namespace, LRCU_LEAF_THREADS per leaf. Scan
+    walks set bits of used instead of a list, and in FENCE and MEMBARRIER
+    namespaces skips leaves nobody entered a read section in since the last scan.
+    Leaves are freed only with the namespace, readers keep &leaf->dirty.
+    Counter and version of registered thread live in its slot here, one
+    cache line each, scanner's own bookkeeping is kept apart in state[],
+    so scan reads slots in a row and writes only lines readers never touch.
+*/
+#define LRCU_LEAF_THREADS 64
+
+/* reader-written */
+struct lrcu_reader_slot {
+    struct lrcu_local_namespace lns;
+} LRCU_ALIGNED;
+
+/* scanner-written, under threads_lock */
+struct lrcu_scan_state {
+    LRCU_TIMER_TYPE timeval; /* when thread was first seen in section */
+    struct lrcu_local_namespace hung_lns;
+};
+
+struct lrcu_leaf {
+    u64 used; /* taken slots, under threads_lock */
+    u64 hung; /* slots of hung threads, worker only */
+    u32 scan; /* dirty as seen by current scan */
+    u64 ctx; /* slots of reader contexts, ti[] is NULL there */
+    struct lrcu_thread_info *ti[LRCU_LEAF_THREADS];
+    struct lrcu_scan_state state[LRCU_LEAF_THREADS];
+    u32 dirty LRCU_ALIGNED; /* reader entered section since last scan */
+    u64 calls LRCU_ALIGNED; /* slots with callbacks in their call queues */
+    struct lrcu_reader_slot slots[LRCU_LEAF_THREADS];
+} LRCU_ALIGNED;
+
+/* slot in ti->slot[ns_id] is leaf * LRCU_LEAF_THREADS + bit + 1, 0 if none */
+#define LRCU_SLOT_LEAF(slot) (((slot) - 1) / LRCU_LEAF_THREADS)
+#define LRCU_SLOT_BIT(slot) (((slot) - 1) % LRCU_LEAF_THREADS)
+
+/* under threads_lock. ti runs over registered threads of leaf, no contexts */
+#define lrcu_leaf_for_each(leaf, bits, ti) \
+        for((bits) = (leaf)->used & ~(leaf)->ctx; (bits) && \
+                ((ti) = (leaf)->ti[__builtin_ctzll(bits)], 1); \
+                (bits) &= (bits) - 1)
+
+/* b runs over all taken slot numbers, contexts too */
+#define lrcu_leaf_for_each_slot(leaf, bits, b) \
+        for((bits) = (leaf)->used; (bits) && \
+                ((b) = __builtin_ctzll(bits), 1); \
+                (bits) &= (bits) - 1)
+
+/* versions of queued callbacks, minv is 0 if none */
+struct lrcu_call_bounds {
+    u64 minv, maxv;
+};
+
+/*
+    Callbacks taken by one worker pass. Segment is checked against
+    unsafe version ranges by its bounds only, and runs as a whole.
+*/
+struct lrcu_call_segment {
+    lrcu_queue_head_t list, hlist;
+    struct lrcu_call_bounds bounds;
+};
+
+struct lrcu_namespace {
+    lrcu_spinlock_t  write_lock;
+    u64 processed_version;
+    u64 gp_completed; /* versions below have no readers. see lrcu_poll_state_ns */
+    u64 gp_requested; /* max cookie lrcu_poll_state_ns waits for */
+    lrcu_spinlock_t  sync_lock; /* one synchronize() scans, others wait for it */
+    struct lrcu_local_namespace **spin_snap; /* under sync_lock */
+    u32 spin_snap_max;
+    u32 sync_timeout;
+    lrcu_spinlock_t  threads_lock;
+    struct lrcu_leaf **leaves; /* under threads_lock */
+    u32 nr_leaves;
+    u32 nr_threads;
+    u8 id;
+    int flavor;
+    u32 gen; /* __lrcu_ns_gen[id] while alive, read caches compare it */
+    bool hazards; /* some thread used hazard slots. never reset */
+    int eventfd; /* lrcu_ns_eventfd(), -1 until asked for */
+
+    /* LRCU_FLAVOR_PERCPU and SLEEPABLE, under threads_lock */
+    struct lrcu_percpu_counter *pcpu;
+    u32 nr_cpus;
+    u32 pcpu_idx; /* current epoch is pcpu_idx & 1 */
+    u64 pcpu_flip_version; /* ns->version when current epoch started */
+    u64 pcpu_safe_version; /* callbacks below this version are safe */
+
+    /* worker only. worker lists collect one pass, then become a segment */
+    struct lrcu_call_segment segs[LRCU_CALL_SEGMENTS];
+    u32 nr_segs;
+    u32 nr_segs_waiting; /* segments waiting for readers, rest are held */
+    bool segs_held; /* only hazard slots keep leftovers. see hazard_release */
+
+    /* with LRCU_LIST_ATOMIC free lists are lock-free stacks in .lh */
+    lrcu_spinlock_t  list_hlock;
+    lrcu_queue_head_t free_hlist, worker_hlist;
+    struct lrcu_call_bounds free_hbounds; /* under list_hlock */
+
+    lrcu_spinlock_t  list_lock;
+    lrcu_queue_head_t free_list, worker_list;
+    struct lrcu_call_bounds free_bounds; /* under list_lock */
+    u64 version LRCU_ALIGNED;
+    struct lrcu_sync_wait sync_wait; /* own cache line, read by unlock */
+} LRCU_ALIGNED;
+
+/*
+    Callbacks of a thread registered in ns. Owner appends, worker takes
+    the whole queue, so retiring threads do not share ns->list_lock.
+*/
+/* lrcu_list_t with struct lrcu_ptr as data */
+#define LRCU_CALL_RECORD_SIZE (sizeof(lrcu_list_t) + sizeof(struct lrcu_ptr))
+
+struct lrcu_call_chunk {
+    struct lrcu_call_chunk *next;
+    u64 records[]; /* LRCU_CALL_POOL_BATCH records */
+};
+
+/* lrcu_call_batch_ns(). retired through head, ptrs copied */
+struct lrcu_call_batch {
+    struct lrcu_ptr_head head;
+    lrcu_destructor_t *destr;
+    size_t n;
+    void *ptrs[];
+};
+
+/* owner thread only */
+struct lrcu_call_cache {
+    lrcu_list_t *head;
+    u32 len;
+};
+
+struct lrcu_call_queue {
+    lrcu_spinlock_t lock; /* owner vs worker only */
+    lrcu_queue_head_t list, hlist;
+    struct lrcu_call_bounds bounds;
+};
+
+
+/* XXX make number of namespaces dynamic??? */
+struct lrcu_thread_info{
+    struct lrcu_handler *h;
+    /* leaf slot while registered in ns, own_lns otherwise */
+    struct lrcu_local_namespace *lns[LRCU_NS_MAX];
+    struct lrcu_local_namespace own_lns[LRCU_NS_MAX];
+    u32 slot[LRCU_NS_MAX]; /* place in ns->leaves, under threads_lock */
+    struct lrcu_leaf *leaf[LRCU_NS_MAX];
+    void *hazards[LRCU_NS_MAX][LRCU_HAZARDS_MAX];
+    struct lrcu_call_queue calls[LRCU_NS_MAX];
+    struct lrcu_call_cache cache;
+};
+
+/*
+    Read section state owned by a coroutine or fiber instead of a thread.
+    Holds a leaf slot of ns, counter and version live there.
+*/
+struct lrcu_reader_ctx {
+    struct lrcu_namespace *ns;
+    struct lrcu_leaf *leaf;
+    lrcu_local_namespace_t *lns; /* &leaf->slots[].lns */
+    u32 *dirty; /* leaf's dirty flag */
+    u32 slot; /* as ti->slot */
+    u8 ns_id;
+};
+
+#define LRCU_GET_LNS_ID(ti, ns_id) ((ti)->lns[(ns_id)])
+#define LRCU_GET_LNS(ti, ns) LRCU_GET_LNS_ID((ti), (ns)->id)
+
+#define LRCU_GET_HANDLER() (__lrcu_handler)
+#define LRCU_SET_HANDLER(x) __lrcu_handler = (x)
+#define LRCU_DEL_HANDLER() __lrcu_handler = NULL
+
+#define LRCU_GET_TI() LRCU_TLS_GET(__lrcu_thread_info)
+#define LRCU_SET_TI(x) LRCU_TLS_SET(__lrcu_thread_info, (x))
+#define LRCU_DEL_TI(x) LRCU_TLS_SET(__lrcu_thread_info, NULL)
+
 #endif /* _LRCU_INTERNAL_H */
\ No newline at end of file
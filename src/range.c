@@ -216,6 +216,8 @@ static inline int bintree_range_value_cmp2(lrcu_range_t *v, lrcu_range_t *r){
 #endif
 
 bool lrcu_rangetree_find(lrcu_rangetree_t *rbt, u64 value){
+    if(rbt->len == 0) /* search below would look at r[0] */
+        return false;
 #ifdef BINTREE_SEARCH_SELF_IMPLEMENTED
     return (bintree_range_search(rbt->r, rbt->len, value) != -1);
 #else
@@ -225,6 +227,24 @@ bool lrcu_rangetree_find(lrcu_rangetree_t *rbt, u64 value){
 #endif
 }
 
+bool lrcu_rangetree_find_range(lrcu_rangetree_t *rbt, u64 minv, u64 maxv){
+    size_t low = 0, high = rbt->len;
+
+    if(rbt->len == 0)
+        return false;
+    LRCU_ASSERT(rbt->sorted);
+    /* first range that ends at minv or later */
+    while(low < high){
+        size_t mid = (low + high) / 2;
+
+        if(rbt->r[mid].maxv < minv)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low < rbt->len && rbt->r[low].minv <= maxv;
+}
+
 /*
 LRCU_EXPORT_SYMBOL(lrcu_rangetree_init);
 LRCU_EXPORT_SYMBOL(lrcu_rangetree_deinit);
@@ -233,4 +253,5 @@ LRCU_EXPORT_SYMBOL(lrcu_rangetree_print);
 LRCU_EXPORT_SYMBOL(lrcu_rangetree_find);
 LRCU_EXPORT_SYMBOL(lrcu_rangetree_optimize);
 LRCU_EXPORT_SYMBOL(lrcu_rangetree_getmin);
+LRCU_EXPORT_SYMBOL(lrcu_rangetree_find_range);
 */
\ No newline at end of file
@@ -36,6 +36,8 @@ bool lrcu_rangetree_find(lrcu_rangetree_t *rbt, u64 value);
 /* true if rbt->len is changed */
 bool lrcu_rangetree_optimize(lrcu_rangetree_t *rbt, int opt_level);
 u64 lrcu_rangetree_getmin(lrcu_rangetree_t *rbt);
+/* true if any range intersects [minv, maxv]. rbt must be optimized */
+bool lrcu_rangetree_find_range(lrcu_rangetree_t *rbt, u64 minv, u64 maxv);
 
 /* 
     What we want to have:
@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <lrcu/lrcu.h>
+
+/*
+    lrcu_call() throughput with 1 to N retiring threads. Registered
+    threads use their own call queues, with 3rd argument 1 threads do not
+    register and share the namespace list and its lock.
+*/
+
+static int loops = 1000;
+static int shared = 0;
+static u64 destroyed;
+
+static u64 now_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void destructor(void *p){
+    (void)p;
+    destroyed++; /* worker only */
+}
+
+static void *retirer(void *arg){
+    int i;
+
+    (void)arg;
+    if(!shared)
+        lrcu_thread_init();
+    for(i = 0; i < loops; i++)
+        lrcu_call(&destroyed, destructor);
+    if(!shared)
+        lrcu_thread_deinit();
+    return NULL;
+}
+
+static void bench(int threads){
+    pthread_t tids[64];
+    u64 ns;
+    int i;
+
+    ns = now_ns();
+    for(i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, retirer, NULL);
+    for(i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    ns = now_ns() - ns;
+    lrcu_barrier();
+    printf("threads %2d: %.0f calls/s\n", threads,
+                (double)loops * threads * 1000000000ULL / ns);
+}
+
+int main(int argc, char *argv[]){
+    int max_threads = 64;
+    int threads;
+
+    if(argc > 1)
+        max_threads = atoi(argv[1]);
+    if(argc > 2)
+        loops = atoi(argv[2]);
+    if(argc > 3)
+        shared = atoi(argv[3]);
+    if(max_threads < 1 || max_threads > 64)
+        max_threads = 64;
+
+    if(__lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    if(lrcu_ns_init(LRCU_NS_DEFAULT) == NULL)
+        return EXIT_FAILURE;
+    lrcu_thread_init();
+
+    for(threads = 1; threads <= max_threads; threads *= 2)
+        bench(threads);
+
+    lrcu_thread_deinit();
+    lrcu_deinit();
+    if(destroyed == 0)
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
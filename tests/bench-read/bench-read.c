@@ -0,0 +1,69 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <lrcu/lrcu.h>
+
+/* Read section cost: inline fast path vs out-of-line lookup */
+
+#if defined(__i386__) || defined(__x86_64__)
+#define BENCH_CYCLES() __builtin_ia32_rdtsc()
+#else
+#define BENCH_CYCLES() 0
+#endif
+
+static u64 now_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define BENCH_RUN(name, loops, lock, unlock) do{ \
+        u64 __i, __ns, __cycles; \
+        __ns = now_ns(); \
+        __cycles = BENCH_CYCLES(); \
+        for(__i = 0; __i < (loops); __i++){ \
+            lock(LRCU_NS_DEFAULT); \
+            unlock(LRCU_NS_DEFAULT); \
+        } \
+        __cycles = BENCH_CYCLES() - __cycles; \
+        __ns = now_ns() - __ns; \
+        printf("%-12s %8.2f ns/section %8.2f cycles/section\n", (name), \
+            (double)__ns / (loops), (double)__cycles / (loops)); \
+    }while(0)
+
+static inline void set_lock(u8 ns_id){
+    lrcu_read_lock_set(LRCU_NS_BIT(ns_id));
+}
+
+static inline void set_unlock(u8 ns_id){
+    lrcu_read_unlock_set(LRCU_NS_BIT(ns_id));
+}
+
+int main(int argc, char *argv[]){
+    u64 loops = 100000000ULL;
+    int flavor = LRCU_FLAVOR_FENCE;
+
+    if(argc > 1)
+        loops = strtoull(argv[1], NULL, 0);
+    if(argc > 2)
+        flavor = atoi(argv[2]);
+
+    if(__lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    if(lrcu_ns_init_flavor(LRCU_NS_DEFAULT, flavor) == NULL)
+        return EXIT_FAILURE;
+    lrcu_thread_init();
+
+    /* warm up */
+    BENCH_RUN("warmup", loops / 10, lrcu_read_lock_ns, lrcu_read_unlock_ns);
+
+    BENCH_RUN("out-of-line", loops, __lrcu_read_lock_ns, __lrcu_read_unlock_ns);
+    BENCH_RUN("inline", loops, lrcu_read_lock_ns, lrcu_read_unlock_ns);
+    BENCH_RUN("set", loops, set_lock, set_unlock);
+
+    lrcu_thread_deinit();
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}
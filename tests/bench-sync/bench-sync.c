@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lrcu/lrcu.h>
+
+/*
+    lrcu_synchronize() latency with readers in short sections.
+    With several writers each calls synchronize concurrently, and
+    throughput shows how well they share scans. Idle threads are
+    registered but never enter a section, they only add to scan cost.
+*/
+
+static volatile int flag = 1;
+static int test_flavor = LRCU_FLAVOR_FENCE;
+
+struct writer_arg {
+    void (*sync)(u8);
+    int loops;
+    u64 total, max;
+};
+
+static u64 now_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *reader(void *arg){
+    volatile u64 work = 0;
+    int i;
+
+    (void)arg;
+    lrcu_thread_init();
+    while(flag){
+        lrcu_read_lock();
+        for(i = 0; i < 100; i++)
+            work++;
+        lrcu_read_unlock();
+        lrcu_quiescent_state();
+    }
+    lrcu_thread_deinit();
+    return NULL;
+}
+
+static void *idle(void *arg){
+    (void)arg;
+    lrcu_thread_init();
+    if(test_flavor == LRCU_FLAVOR_QSBR)
+        lrcu_thread_offline();
+    while(flag)
+        usleep(10000);
+    lrcu_thread_deinit();
+    return NULL;
+}
+
+static void *writer(void *arg){
+    struct writer_arg *w = arg;
+    u64 ns;
+    int i;
+
+    for(i = 0; i < w->loops; i++){
+        ns = now_ns();
+        w->sync(LRCU_NS_DEFAULT);
+        ns = now_ns() - ns;
+        w->total += ns;
+        if(ns > w->max)
+            w->max = ns;
+    }
+    return NULL;
+}
+
+static void bench(const char *name, void (*sync)(u8), int readers,
+                                    int writers, int idlers, int loops){
+    struct writer_arg args[64];
+    pthread_t tids[64];
+    u64 ns, max = 0, total = 0;
+    int i;
+
+    ns = now_ns();
+    for(i = 0; i < writers; i++){
+        args[i] = (struct writer_arg){ .sync = sync, .loops = loops };
+        pthread_create(&tids[i], NULL, writer, &args[i]);
+    }
+    for(i = 0; i < writers; i++){
+        pthread_join(tids[i], NULL);
+        total += args[i].total;
+        if(args[i].max > max)
+            max = args[i].max;
+    }
+    ns = now_ns() - ns;
+    printf("%s: readers %d writers %d idle %d avg %.2f us max %.2f us %.0f syncs/s\n",
+            name, readers, writers, idlers, (double)total / loops / writers / 1000,
+            (double)max / 1000, (double)loops * writers * 1000000000ULL / ns);
+}
+
+int main(int argc, char *argv[]){
+    pthread_t tids[64], *idle_tids = NULL;
+    int readers = 2, loops = 1000, writers = 1, idlers = 0;
+    pthread_attr_t attr;
+    int i;
+
+    if(argc > 1)
+        readers = atoi(argv[1]);
+    if(argc > 2)
+        loops = atoi(argv[2]);
+    if(argc > 3)
+        test_flavor = atoi(argv[3]);
+    if(argc > 4)
+        writers = atoi(argv[4]);
+    if(readers > 64)
+        readers = 64;
+    if(writers < 1 || writers > 64)
+        writers = 1;
+    if(argc > 5)
+        idlers = atoi(argv[5]);
+    if(idlers > 0)
+        idle_tids = calloc(idlers, sizeof(pthread_t));
+    if(idle_tids == NULL)
+        idlers = 0;
+
+    if(__lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    if(lrcu_ns_init_flavor(LRCU_NS_DEFAULT, test_flavor) == NULL)
+        return EXIT_FAILURE;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    for(i = 0; i < idlers; i++)
+        if(pthread_create(&idle_tids[i], &attr, idle, NULL))
+            break;
+    idlers = i;
+    for(i = 0; i < readers; i++)
+        pthread_create(&tids[i], NULL, reader, NULL);
+    usleep(100000); /* let idle threads register */
+
+    bench("synchronize", lrcu_synchronize_ns, readers, writers, idlers, loops);
+    bench("expedited", lrcu_synchronize_expedited_ns, readers, writers,
+                                                            idlers, loops);
+
+    flag = 0;
+    for(i = 0; i < readers; i++)
+        pthread_join(tids[i], NULL);
+    for(i = 0; i < idlers; i++)
+        pthread_join(idle_tids[i], NULL);
+    free(idle_tids);
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}
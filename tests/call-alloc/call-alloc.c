@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <lrcu/lrcu.h>
+
+/*
+    lrcu_call() takes callback records from a per-thread cache, refilled
+    from records the worker gave back. Once they came back, retiring as
+    many objects again must not call malloc at all. Second round runs in
+    read section, so the worker does not touch the pool meanwhile. malloc
+    is wrapped here (glibc) and counted for the calling thread only.
+    Before all that malloc fails once, with nothing in pool yet: then
+    lrcu_call() must destroy the object itself, never drop it.
+*/
+
+#define CALLS 4096
+
+extern void *__libc_malloc(size_t size);
+
+static __thread unsigned long mallocs;
+static __thread int no_memory;
+static __thread int destroyed_here;
+static int destroyed;
+
+void *malloc(size_t size){
+    mallocs++;
+    if(no_memory)
+        return NULL;
+    return __libc_malloc(size);
+}
+
+static void destructor(void *p){
+    (void)p;
+    destroyed_here++;
+    lrcu_atomic_inc(&destroyed);
+}
+
+static unsigned long retire(int calls){
+    unsigned long before = mallocs;
+    int i;
+
+    for(i = 0; i < calls; i++)
+        lrcu_call(&destroyed, destructor);
+    return mallocs - before;
+}
+
+int main(void){
+    unsigned long first, second;
+    int records;
+
+    if(__lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    if(lrcu_ns_init(LRCU_NS_DEFAULT) == NULL)
+        return EXIT_FAILURE;
+    lrcu_thread_init();
+
+    no_memory = 1;
+    lrcu_call(&destroyed, destructor);
+    no_memory = 0;
+    if(destroyed_here != 1)
+        return EXIT_FAILURE;
+
+    first = retire(CALLS);
+    lrcu_barrier();
+    /* worker could return some while we were still retiring */
+    records = first * LRCU_CALL_POOL_BATCH;
+
+    lrcu_read_lock();
+    second = retire(records);
+    lrcu_read_unlock();
+    lrcu_barrier();
+
+    lrcu_thread_deinit();
+    lrcu_deinit();
+
+    printf("call-alloc: %d calls, %lu mallocs, then %d calls, %lu mallocs\n",
+                                        CALLS, first, records, second);
+    if(destroyed != 1 + CALLS + records)
+        return EXIT_FAILURE;
+    /* one chunk per LRCU_CALL_POOL_BATCH records at most */
+    if(first > CALLS / LRCU_CALL_POOL_BATCH || second != 0)
+        return EXIT_FAILURE;
+    printf("call-alloc: ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <lrcu/lrcu.h>
+
+#include "../common/common.h"
+
+/*
+    Batched retire: a batch and a chain of heads wait for a reader that
+    was in section, then are destroyed whole. A hazard slot on one
+    pointer holds back its whole batch.
+*/
+
+#define BATCH 10000
+#define HEADS 1000
+
+static void *ptrs[BATCH];
+static volatile int freed_head = 0;
+static struct shared_data *shptr;
+
+static void batch_head_destructor(void *p){
+    shared_data_head_destructor(p);
+    freed--;
+    freed_head++;
+}
+
+static void fill_batch(void){
+    int i;
+
+    for(i = 0; i < BATCH; i++)
+        ptrs[i] = shared_data_constructor();
+}
+
+static struct lrcu_ptr_head *make_chain(void){
+    struct lrcu_ptr_head *first = NULL;
+    int i;
+
+    for(i = 0; i < HEADS; i++){
+        struct shared_data *n = shared_data_constructor();
+
+        n->lrcu_head.list.next = first ? &first->list : NULL;
+        first = &n->lrcu_head;
+    }
+    return first;
+}
+
+int main(void){
+    pthread_t tid;
+    struct shared_data *p;
+
+    if(lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    lrcu_thread_init();
+
+    section_enter(&tid, NULL);
+
+    fill_batch();
+    lrcu_call_batch(ptrs, BATCH, shared_data_destructor);
+    lrcu_call_head_batch(make_chain(), batch_head_destructor);
+
+    /* reader could see all of them */
+    assert_held(&freed, 0);
+    LRCU_ASSERT(freed_head == 0);
+
+    section_leave(tid);
+    lrcu_barrier();
+    LRCU_ASSERT(freed == BATCH && freed_head == HEADS);
+
+    /* one protected pointer holds back its batch */
+    fill_batch();
+    shptr = ptrs[BATCH / 2];
+    p = lrcu_hazard_protect(0, shptr);
+    LRCU_ASSERT(p == ptrs[BATCH / 2]);
+    lrcu_write_lock();
+    lrcu_assign_pointer(shptr, NULL);
+    lrcu_write_unlock();
+    lrcu_call_batch(ptrs, BATCH, shared_data_destructor);
+
+    /* protected batch does not hold the barrier */
+    lrcu_barrier();
+    LRCU_ASSERT(freed == BATCH && p->c == 1);
+    lrcu_hazard_release(0);
+    wait_for(&freed, 2 * BATCH);
+
+    printf("call-batch: ok\n");
+    lrcu_thread_deinit();
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}
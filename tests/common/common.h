@@ -0,0 +1,104 @@
+#ifndef __LRCU_TESTS_COMMON_H__
+#define __LRCU_TESTS_COMMON_H__
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <lrcu/lrcu.h>
+
+/*
+    Pieces shared by tests/<name>/<name>.c: retired object, destructors
+    that count it, waits for the worker and a reader holding a section.
+*/
+
+struct shared_data{
+    u64 c;
+    lrcu_ptr_head_t lrcu_head;
+};
+
+static volatile int freed = 0;
+
+static inline void shared_data_destructor(void *p){
+    struct shared_data *data = p;
+
+    LRCU_ASSERT(data->c == 1);
+    data->c = 0;
+    free(data);
+    freed++;
+}
+
+static inline void shared_data_head_destructor(void *p){
+    shared_data_destructor(container_of(p, struct shared_data, lrcu_head));
+}
+
+/* head is left uninitialized, lrcu_call_head() does not need it */
+static inline struct shared_data *shared_data_constructor(void){
+    struct shared_data *data = malloc(sizeof(struct shared_data));
+
+    LRCU_ASSERT(data);
+    data->c = 1;
+    return data;
+}
+
+/* worker frees it sooner or later */
+static inline void wait_for(volatile int *v, int val){
+    int i;
+
+    for(i = 0; i < 10000 && *v != val; i++)
+        usleep(LRCU_WORKER_SLEEP_US);
+    LRCU_ASSERT(*v == val);
+}
+
+/*
+    Reader still holds what was retired: grace period started now must
+    not end. Each poll kicks the worker into one more scan.
+*/
+static inline void assert_held(volatile int *v, int val){
+    u64 cookie = lrcu_get_state();
+    int i;
+
+    for(i = 0; i < 10; i++){
+        LRCU_ASSERT(!lrcu_poll_state(cookie));
+        usleep(LRCU_WORKER_SLEEP_US);
+    }
+    LRCU_ASSERT(*v == val);
+}
+
+/*
+    Registered reader: enters section, checks what it saw there is still
+    alive when told to leave. in_section drops right before the unlock.
+*/
+static volatile int in_section = 0, leave = 0;
+
+static inline void *section_reader(void *arg){
+    struct shared_data **shp = arg, *data = NULL;
+
+    lrcu_thread_init();
+    lrcu_read_lock();
+    if(shp)
+        data = lrcu_dereference(*shp);
+    in_section = 1;
+    while(!leave)
+        usleep(LRCU_WORKER_SLEEP_US);
+    if(data)
+        LRCU_ASSERT(data->c == 1);
+    in_section = 0;
+    lrcu_read_unlock();
+    lrcu_thread_deinit();
+    return NULL;
+}
+
+/* shp may be NULL, reader then holds the section only */
+static inline void section_enter(pthread_t *tid, struct shared_data **shp){
+    in_section = leave = 0;
+    pthread_create(tid, NULL, section_reader, shp);
+    wait_for(&in_section, 1);
+}
+
+static inline void section_leave(pthread_t tid){
+    leave = 1;
+    pthread_join(tid, NULL);
+}
+
+#endif /* __LRCU_TESTS_COMMON_H__ */
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <lrcu/lrcu.hpp>
+
+/* C++ API: read_guard, typed ptr, retire with generated destructor */
+
+struct shared_data {
+    u64 c;
+
+    explicit shared_data(u64 v) : c(v) {
+        lrcu_atomic_inc(&alive);
+    }
+    ~shared_data(){
+        LRCU_ASSERT(c != 0);
+        c = 0;
+        lrcu_atomic_dec(&alive);
+    }
+
+    static i64 alive;
+};
+i64 shared_data::alive = 0;
+
+static lrcu::ptr<shared_data> *shptr;
+static volatile int flag = 1;
+
+static void *reader(void *){
+    u64 processed = 0, last = 0;
+
+    lrcu_thread_init();
+    while(flag){
+        lrcu::read_guard<> g;
+        shared_data *data = shptr->get();
+
+        if(data){
+            LRCU_ASSERT(data->c != 0);
+            LRCU_ASSERT(data->c >= last); /* only goes forward */
+            last = data->c;
+        }
+        processed++;
+    }
+    printf("reader: processed %" PRIu64 "\n", processed);
+    lrcu_thread_deinit();
+    return NULL;
+}
+
+static void *writer(void *){
+    u64 processed = 0;
+
+    lrcu_thread_init();
+    while(flag){
+        lrcu_write_lock();
+        shptr->publish(new shared_data(++processed));
+        lrcu_write_unlock();
+        if(processed % 1000 == 0)
+            LRCU_YIELD();
+    }
+    printf("writer: processed %" PRIu64 "\n", processed);
+    lrcu_thread_deinit();
+    return NULL;
+}
+
+int main(int argc, char *argv[]){
+    pthread_t r_tids[2], w_tid;
+    int total_timer = 2;
+    int i;
+
+    if(argc > 1)
+        total_timer = atoi(argv[1]);
+
+    lrcu_init();
+    lrcu_thread_init();
+    shptr = new lrcu::ptr<shared_data>(new shared_data(1));
+
+    for(i = 0; i < 2; i++){
+        if(pthread_create(&r_tids[i], NULL, reader, NULL))
+            exit(EXIT_FAILURE);
+    }
+    if(pthread_create(&w_tid, NULL, writer, NULL))
+        exit(EXIT_FAILURE);
+
+    usleep(total_timer * 1000000);
+    flag = 0;
+
+    for(i = 0; i < 2; i++)
+        pthread_join(r_tids[i], NULL);
+    pthread_join(w_tid, NULL);
+
+    /* free function retire, same generated destructor */
+    lrcu::retire(new shared_data(1));
+    lrcu::retire<LRCU_NS_DEFAULT>(new shared_data(1));
+
+    /* only the published object is left */
+    lrcu::wait_callbacks();
+    LRCU_ASSERT(shared_data::alive == 1);
+
+    delete shptr;
+    lrcu::wait_callbacks();
+    LRCU_ASSERT(shared_data::alive == 0);
+    printf("alive: %" PRIi64 "\n", shared_data::alive);
+
+    lrcu_thread_deinit();
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lrcu/lrcu.h>
+
+#include "../common/common.h"
+
+/*
+    Reference upgrade: object taken with lrcu_dereference_get() outlives
+    both read section and grace period until it is put. Heads retired
+    with plain lrcu_call_head() are not tracked and need no init.
+*/
+
+static struct shared_data *shptr;
+
+static struct shared_data *shared_data_ref_constructor(void){
+    struct shared_data *data = shared_data_constructor();
+
+    lrcu_ptr_head_init(&data->lrcu_head);
+    return data;
+}
+
+static void unpublish(void){
+    lrcu_write_lock();
+    lrcu_assign_pointer(shptr, NULL);
+    lrcu_write_unlock();
+}
+
+int main(void){
+    struct shared_data *data, *ref;
+
+    if(lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    lrcu_thread_init();
+
+    /* put after the worker has seen grace period destroys it */
+    data = shptr = shared_data_ref_constructor();
+    lrcu_read_lock();
+    ref = lrcu_dereference_get(shptr, lrcu_head);
+    lrcu_read_unlock();
+    LRCU_ASSERT(ref == data);
+
+    unpublish();
+    lrcu_call_head_ref(&data->lrcu_head, shared_data_head_destructor);
+    lrcu_barrier();
+    LRCU_ASSERT(freed == 0);
+    LRCU_ASSERT(ref->c == 1);
+
+    lrcu_put(ref, lrcu_head);
+    LRCU_ASSERT(freed == 1);
+
+    /* put before the worker gets to it */
+    data = shptr = shared_data_ref_constructor();
+    lrcu_read_lock();
+    ref = lrcu_dereference_get(shptr, lrcu_head);
+    lrcu_read_unlock();
+    lrcu_put(ref, lrcu_head);
+
+    unpublish();
+    lrcu_call_head_ref(&data->lrcu_head, shared_data_head_destructor);
+    lrcu_barrier();
+    LRCU_ASSERT(freed == 2);
+
+    /* garbage in untracked head */
+    data = shptr = shared_data_constructor();
+    memset(&data->lrcu_head, 0xa5, sizeof(data->lrcu_head));
+    unpublish();
+    lrcu_call_head(&data->lrcu_head, shared_data_head_destructor);
+    lrcu_barrier();
+    LRCU_ASSERT(freed == 3);
+
+    printf("deref-get: ok\n");
+    lrcu_thread_deinit();
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <lrcu/lrcu.h>
+
+#include "../common/common.h"
+
+/*
+    lrcu_synchronize_expedited: waits for reader that outlives the spin,
+    returns without it otherwise. Releaser lets the reader go only after
+    it saw the grace period held for a while, so the fallback has to wait.
+*/
+
+static void *releaser(void *arg){
+    (void)arg;
+    assert_held(&in_section, 1);
+    leave = 1;
+    return NULL;
+}
+
+static void run(int flavor){
+    pthread_t tid, rtid;
+    u64 cookie;
+    int i;
+
+    if(__lrcu_init() == NULL)
+        exit(EXIT_FAILURE);
+    if(lrcu_ns_init_flavor(LRCU_NS_DEFAULT, flavor) == NULL)
+        exit(EXIT_FAILURE);
+
+    for(i = 0; i < 1000; i++){
+        cookie = lrcu_get_state();
+        lrcu_synchronize_expedited();
+        LRCU_ASSERT(lrcu_poll_state(cookie));
+    }
+
+    section_enter(&tid, NULL);
+    cookie = lrcu_get_state();
+    LRCU_ASSERT(!lrcu_poll_state(cookie));
+    pthread_create(&rtid, NULL, releaser, NULL);
+    lrcu_synchronize_expedited();
+    LRCU_ASSERT(!in_section && lrcu_poll_state(cookie));
+    pthread_join(rtid, NULL);
+    section_leave(tid);
+
+    printf("expedited: flavor %d ok\n", flavor);
+    lrcu_deinit();
+}
+
+int main(int argc, char *argv[]){
+    int flavor;
+
+    if(argc > 1){
+        run(atoi(argv[1]));
+        return EXIT_SUCCESS;
+    }
+    for(flavor = 0; flavor < LRCU_FLAVOR_MAX; flavor++)
+        run(flavor);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <lrcu/lrcu.h>
+
+#include "../common/common.h"
+
+/*
+    Hazard pointers: protected object survives its grace period while
+    other retired objects of the same namespace are freed.
+*/
+
+static struct shared_data *shptr, *shptr_head;
+static volatile int freed_head = 0;
+
+static void hazard_head_destructor(void *p){
+    shared_data_head_destructor(p);
+    freed--;
+    freed_head++;
+}
+
+int main(void){
+    struct shared_data *data, *data_head, *other, *p, *ph;
+
+    if(lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    lrcu_thread_init();
+
+    data = shptr = shared_data_constructor();
+    data_head = shptr_head = shared_data_constructor();
+    other = shared_data_constructor();
+
+    /* no read section */
+    p = lrcu_hazard_protect(0, shptr);
+    ph = lrcu_hazard_protect_head(1, shptr_head, lrcu_head);
+    LRCU_ASSERT(p == data && ph == data_head);
+
+    lrcu_write_lock();
+    lrcu_assign_pointer(shptr, NULL);
+    lrcu_assign_pointer(shptr_head, NULL);
+    lrcu_write_unlock();
+    lrcu_call(data, shared_data_destructor);
+    lrcu_call_head(&data_head->lrcu_head, hazard_head_destructor);
+    lrcu_call(other, shared_data_destructor);
+
+    /* other one is not held back, protected ones do not hold the barrier */
+    lrcu_barrier();
+    LRCU_ASSERT(freed == 1 && freed_head == 0);
+    LRCU_ASSERT(p->c == 1 && ph->c == 1);
+
+    lrcu_hazard_release(0);
+    wait_for(&freed, 2);
+    LRCU_ASSERT(freed_head == 0);
+
+    lrcu_hazard_release(1);
+    wait_for(&freed_head, 1);
+
+    printf("hazard: ok\n");
+    lrcu_thread_deinit();
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/* reader pauses in inline read_lock after its counter, before the mark */
+static void reader_stall(void);
+#define LRCU_READ_MARK_STALL() reader_stall()
+
+#include <lrcu/lrcu.h>
+
+#include "../common/common.h"
+
+/*
+    Leaf skipping: reader stalls between its counter store and the leaf
+    mark while scans clear the mark. It then loads an object that gets
+    retired, and the object must live until the reader leaves.
+*/
+
+static struct shared_data *shptr;
+static volatile int stall_armed = 0, stalled = 0, go = 0;
+static volatile int holding = 0;
+
+static void reader_stall(void){
+    if(!stall_armed)
+        return;
+    stall_armed = 0;
+    stalled = 1;
+    while(!go)
+        usleep(LRCU_WORKER_SLEEP_US);
+}
+
+static void *reader(void *arg){
+    struct shared_data *p;
+
+    (void)arg;
+    lrcu_thread_init();
+    /* fills read cache and marks the leaf */
+    lrcu_read_lock();
+    lrcu_read_unlock();
+
+    stall_armed = 1;
+    lrcu_read_lock();
+    p = lrcu_dereference(shptr);
+    LRCU_ASSERT(p);
+    holding = 1;
+    while(!leave)
+        usleep(LRCU_WORKER_SLEEP_US);
+    LRCU_ASSERT(p->c == 1);
+    lrcu_read_unlock();
+    lrcu_thread_deinit();
+    return NULL;
+}
+
+static void run(int flavor){
+    struct shared_data *data;
+    pthread_t tid;
+
+    stalled = go = holding = leave = 0;
+    freed = 0;
+    if(__lrcu_init() == NULL)
+        exit(EXIT_FAILURE);
+    if(lrcu_ns_init_flavor(LRCU_NS_DEFAULT, flavor) == NULL)
+        exit(EXIT_FAILURE);
+    lrcu_thread_init();
+    data = shptr = shared_data_constructor();
+
+    pthread_create(&tid, NULL, reader, NULL);
+    wait_for(&stalled, 1);
+    /* scans clear the mark, reader's counter keeps them from finishing */
+    assert_held(&freed, 0);
+    go = 1;
+    wait_for(&holding, 1);
+
+    lrcu_write_lock();
+    lrcu_assign_pointer(shptr, NULL);
+    lrcu_write_unlock();
+    lrcu_call(data, shared_data_destructor);
+    assert_held(&freed, 0);
+
+    leave = 1;
+    pthread_join(tid, NULL);
+    lrcu_barrier();
+    LRCU_ASSERT(freed == 1);
+
+    lrcu_thread_deinit();
+    lrcu_deinit();
+}
+
+int main(void){
+    run(LRCU_FLAVOR_FENCE);
+    run(LRCU_FLAVOR_MEMBARRIER);
+
+    printf("leaf-stall: ok\n");
+    return EXIT_SUCCESS;
+}
@@ -17,6 +17,8 @@ struct shared_ptr{
     int flag;
 };
 
+static int test_flavor = LRCU_FLAVOR_FENCE;
+
 struct shared_data{
     u64 c;
     struct shared_ptr *shptr;
@@ -64,7 +66,10 @@ void shared_data_release(struct shared_data *data){
 void *reader(void *arg){
     struct shared_ptr *shptr = (struct shared_ptr *)arg;
     u64 processed = 0, accrel = 0;
-    lrcu_thread_init();
+
+    /* LRCU_FLAVOR_PERCPU readers need no registration */
+    if(test_flavor != LRCU_FLAVOR_PERCPU)
+        lrcu_thread_init();
 
     while(shptr->flag){
         lrcu_read_lock();
@@ -73,13 +78,15 @@ void *reader(void *arg){
             accrel++;
         processed++;
         lrcu_read_unlock();
+        lrcu_quiescent_state(); /* LRCU_FLAVOR_QSBR */
         if(shptr->reader_timer)
             usleep(shptr->reader_timer);
     }
     printf("reader: processed %"PRIu64"; accessed released %"PRIu64"\n",
             processed, accrel);
 
-    lrcu_thread_deinit();
+    if(test_flavor != LRCU_FLAVOR_PERCPU)
+        lrcu_thread_deinit();
     return NULL;
 }
 
@@ -93,13 +100,14 @@ void *writer(void *arg){
         lrcu_write_lock();
         struct shared_data *data = shptr->ptr;
 
-        /* no need for lrcu_assign_pointer() since we are under lock */
-        shptr->ptr = shared_data_constructor(shptr, data);
+        /* the lock only orders writers, readers need the publication */
+        lrcu_assign_pointer(shptr->ptr, shared_data_constructor(shptr, data));
         processed++;
         lrcu_write_unlock();
         if(shptr->writer_timer)
             usleep(shptr->writer_timer);
         shared_data_release(data);
+        lrcu_quiescent_state();
     }
     printf("writer: processed %"PRIu64"\n", processed);
 
@@ -124,6 +132,8 @@ int main(int argc, char *argv[]){
         readers = atoi(argv[2]);
     if(argc > 3)
         writers = atoi(argv[3]);
+    if(argc > 4)
+        test_flavor = atoi(argv[4]);
     r_tids = malloc(readers * sizeof(pthread_t));
     w_tids = malloc(writers * sizeof(pthread_t));
     if(r_tids == NULL || w_tids == NULL){
@@ -131,7 +141,8 @@ int main(int argc, char *argv[]){
         goto out;
     }
 
-    lrcu_init();
+    __lrcu_init();
+    lrcu_ns_init_flavor(LRCU_NS_DEFAULT, test_flavor);
     lrcu_thread_init();
 
     for(i = 0; i < readers; i++){
@@ -142,6 +153,8 @@ int main(int argc, char *argv[]){
         if(pthread_create(&w_tids[i], NULL, writer, (void *)&shptr))
             exit(EXIT_FAILURE);
     }
+    if(test_flavor == LRCU_FLAVOR_QSBR)
+        lrcu_thread_offline(); /* main thread does not read */
     usleep(total_timer);
     shptr.flag = 0;
 
@@ -120,6 +120,48 @@ void unlink_some(uintptr_t u1, uintptr_t u2){
     LRCU_ASSERT(cnt == 3);
 }
 
+/* unlink u1 and u2 from 1..5, then append 6: order and tail must hold */
+void queue_unlink_some(uintptr_t u1, uintptr_t u2){
+    lrcu_queue_head_t q, q2;
+    lrcu_list_t *n, *n_prev;
+    uintptr_t d, expect;
+
+    lrcu_queue_init(&q);
+    lrcu_queue_init(&q2);
+    for(d = 1; d <= 5; d++)
+        lrcu_queue_add(&q, d);
+
+    lrcu_list_for_each(n, n_prev, &q.lh){
+        uintptr_t *nd = (uintptr_t *)n->data;
+        if(*nd == u1 || *nd == u2){
+            lrcu_queue_unlink_next(&q, n_prev);
+            LRCU_FREE(n);
+        }
+    }
+    d = 6;
+    lrcu_queue_add(&q2, d);
+    lrcu_queue_splice(&q, &q2);
+    LRCU_ASSERT(lrcu_queue_empty(&q2));
+    LRCU_ASSERT(*(uintptr_t *)q.tail->data == 6);
+
+    expect = 1;
+    lrcu_list_for_each(n, n_prev, &q.lh){
+        uintptr_t *nd = (uintptr_t *)n->data;
+        while(expect == u1 || expect == u2)
+            expect++;
+        LRCU_ASSERT(*nd == expect);
+        expect++;
+    }
+    LRCU_ASSERT(expect == 7);
+
+    while(!lrcu_queue_empty(&q)){
+        n = q.lh.head;
+        lrcu_queue_unlink_next(&q, NULL);
+        LRCU_FREE(n);
+    }
+    LRCU_ASSERT(q.tail == NULL);
+}
+
 int main(void){
     lrcu_list_head_t lh = {0};
     lrcu_list_head_t lh2 = {0};
@@ -295,6 +337,13 @@ int main(void){
     unlink_some(3, 4);
     unlink_some(4, 5);
 
+    /* tail-tracked queue keeps insertion order through unlink and splice */
+    queue_unlink_some(1, 2);
+    queue_unlink_some(1, 5);
+    queue_unlink_some(2, 4);
+    queue_unlink_some(4, 5);
+    queue_unlink_some(5, 5);
+
     /* TODO free data. deallocate data. atomic list. insert */
 
     return 0;
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <lrcu/lrcu.h>
+#include <lrcu/atomics.h>
+
+#include "../common/common.h"
+
+/*
+    More registered threads than LRCU_THREADS_MAX: every hazard slot of
+    every thread is collected, so an unprotected object is still freed,
+    and expedited synchronize waits for all readers.
+*/
+
+#define THREADS (LRCU_THREADS_MAX + 72)
+
+static struct shared_data *protected[THREADS][LRCU_HAZARDS_MAX];
+static volatile int ready = 0, left = 0;
+static volatile int phase = 0;
+
+static void *worker(void *arg){
+    long idx = (long)arg;
+    int j;
+
+    lrcu_thread_init();
+    for(j = 0; j < LRCU_HAZARDS_MAX; j++)
+        lrcu_hazard_protect(j, protected[idx][j]);
+    lrcu_atomic_inc(&ready);
+    while(phase != 1)
+        usleep(LRCU_WORKER_SLEEP_US);
+    for(j = 0; j < LRCU_HAZARDS_MAX; j++)
+        lrcu_hazard_release(j);
+
+    lrcu_read_lock();
+    lrcu_atomic_inc(&ready);
+    while(phase != 3)
+        usleep(LRCU_WORKER_SLEEP_US);
+    lrcu_atomic_inc(&left);
+    lrcu_read_unlock();
+    lrcu_thread_deinit();
+    return NULL;
+}
+
+/* lets readers go once main is about to wait for them */
+static void *releaser(void *arg){
+    (void)arg;
+    while(phase != 2)
+        usleep(LRCU_WORKER_SLEEP_US);
+    phase = 3;
+    return NULL;
+}
+
+int main(void){
+    pthread_t tids[THREADS], rtid;
+    struct shared_data *data;
+    long i;
+    int j;
+
+    if(lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    lrcu_thread_init();
+
+    for(i = 0; i < THREADS; i++)
+        for(j = 0; j < LRCU_HAZARDS_MAX; j++)
+            protected[i][j] = shared_data_constructor();
+    for(i = 0; i < THREADS; i++)
+        pthread_create(&tids[i], NULL, worker, (void *)i);
+    wait_for(&ready, THREADS);
+
+    /* all slots are set, none points to it */
+    data = shared_data_constructor();
+    lrcu_call(data, shared_data_destructor);
+    lrcu_barrier();
+    LRCU_ASSERT(freed == 1);
+
+    ready = 0;
+    phase = 1;
+    wait_for(&ready, THREADS);
+
+    pthread_create(&rtid, NULL, releaser, NULL);
+    phase = 2;
+    lrcu_synchronize_expedited();
+    LRCU_ASSERT(left == THREADS);
+
+    pthread_join(rtid, NULL);
+    for(i = 0; i < THREADS; i++)
+        pthread_join(tids[i], NULL);
+    for(i = 0; i < THREADS; i++)
+        for(j = 0; j < LRCU_HAZARDS_MAX; j++)
+            free(protected[i][j]);
+
+    printf("many-threads: ok\n");
+    lrcu_thread_deinit();
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <lrcu/lrcu.h>
+
+/*
+    Namespace freed and created again while a reader thread keeps its
+    read cache: next read_lock must not use the freed namespace, and it
+    enters the new one with its flavor.
+*/
+
+static volatile int step = 0;
+
+static void *reader(void *arg){
+    (void)arg;
+    lrcu_thread_init();
+    lrcu_read_lock();
+    lrcu_read_unlock();
+    step = 1;
+    while(step != 2)
+        usleep(LRCU_WORKER_SLEEP_US);
+    /* cache still points to freed namespace */
+    lrcu_read_lock();
+    lrcu_read_unlock();
+    lrcu_thread_deinit();
+    return NULL;
+}
+
+int main(void){
+    pthread_t tid;
+
+    if(lrcu_init() == NULL)
+        return EXIT_FAILURE;
+
+    pthread_create(&tid, NULL, reader, NULL);
+    while(step != 1)
+        usleep(LRCU_WORKER_SLEEP_US);
+    lrcu_ns_deinit(LRCU_NS_DEFAULT);
+    if(lrcu_ns_init_flavor(LRCU_NS_DEFAULT, LRCU_FLAVOR_PERCPU) == NULL)
+        return EXIT_FAILURE;
+    step = 2;
+    pthread_join(tid, NULL);
+    /* reader went to percpu counters, not to the old slot */
+    lrcu_synchronize();
+
+    printf("ns-reinit: ok\n");
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <lrcu/lrcu.h>
+
+#include "../common/common.h"
+
+/*
+    Polled grace periods: cookie stays unsatisfied while a reader that
+    could see the object is in section, worker completes it without any
+    callbacks queued, cond_synchronize does not block once satisfied.
+*/
+
+static bool poll_wait(u64 cookie){
+    int i;
+
+    for(i = 0; i < 10000; i++){
+        if(lrcu_poll_state(cookie))
+            return true;
+        /* QSBR: polling thread itself holds the cookie otherwise */
+        lrcu_quiescent_state();
+        usleep(LRCU_WORKER_SLEEP_US);
+    }
+    return false;
+}
+
+int main(int argc, char *argv[]){
+    int flavor = LRCU_FLAVOR_FENCE;
+    pthread_t tid;
+    u64 cookie;
+
+    if(argc > 1)
+        flavor = atoi(argv[1]);
+
+    if(__lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    if(lrcu_ns_init_flavor(LRCU_NS_DEFAULT, flavor) == NULL)
+        return EXIT_FAILURE;
+    lrcu_thread_init();
+
+    /* no readers at all */
+    cookie = lrcu_get_state();
+    LRCU_ASSERT(poll_wait(cookie));
+    lrcu_cond_synchronize(cookie);
+
+    /* reader holds the cookie */
+    section_enter(&tid, NULL);
+    cookie = lrcu_get_state();
+    assert_held(&in_section, 1);
+    LRCU_ASSERT(!lrcu_poll_state(cookie));
+    leave = 1;
+    LRCU_ASSERT(poll_wait(cookie));
+    section_leave(tid);
+
+    /* synchronize satisfies older cookies */
+    cookie = lrcu_get_state();
+    lrcu_synchronize();
+    LRCU_ASSERT(lrcu_poll_state(cookie));
+
+    cookie = lrcu_get_state();
+    lrcu_cond_synchronize(cookie);
+    LRCU_ASSERT(lrcu_poll_state(cookie));
+
+    printf("poll-state: ok\n");
+    lrcu_thread_deinit();
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <lrcu/lrcu.h>
+
+#include "../common/common.h"
+
+/*
+    Reader context migration: section is entered on one thread and left
+    on another. Object retired in between must live until the second one.
+*/
+
+static struct lrcu_reader_ctx *ctx;
+static struct shared_data *shptr;
+static struct shared_data *seen;
+
+static void *reader_enter(void *arg){
+    (void)arg;
+    lrcu_read_lock_ctx(ctx);
+    seen = lrcu_dereference(shptr);
+    return NULL;
+}
+
+static void *reader_leave(void *arg){
+    (void)arg;
+    LRCU_ASSERT(seen->c == 1);
+    lrcu_read_unlock_ctx(ctx);
+    return NULL;
+}
+
+static void run(void *(*fn)(void *)){
+    pthread_t tid;
+
+    pthread_create(&tid, NULL, fn, NULL);
+    pthread_join(tid, NULL);
+}
+
+static void run_flavor(int flavor){
+    struct shared_data *data;
+
+    freed = 0;
+    if(__lrcu_init() == NULL)
+        exit(EXIT_FAILURE);
+    if(lrcu_ns_init_flavor(LRCU_NS_DEFAULT, flavor) == NULL)
+        exit(EXIT_FAILURE);
+
+    ctx = lrcu_reader_ctx_init(LRCU_NS_DEFAULT);
+    LRCU_ASSERT(ctx);
+
+    data = shptr = shared_data_constructor();
+
+    run(reader_enter);
+    LRCU_ASSERT(seen == data);
+
+    /* reader thread is gone, its section is not */
+    lrcu_write_lock();
+    lrcu_assign_pointer(shptr, NULL);
+    lrcu_write_unlock();
+    lrcu_call(data, shared_data_destructor);
+
+    assert_held(&freed, 0);
+
+    run(reader_leave);
+    lrcu_barrier();
+    LRCU_ASSERT(freed == 1);
+
+    lrcu_reader_ctx_deinit(ctx);
+    printf("reader-ctx: flavor %d ok\n", flavor);
+    lrcu_deinit();
+}
+
+int main(int argc, char *argv[]){
+    int flavor;
+
+    if(argc > 1){
+        run_flavor(atoi(argv[1]));
+        return EXIT_SUCCESS;
+    }
+    for(flavor = 0; flavor < LRCU_FLAVOR_MAX; flavor++)
+        run_flavor(flavor);
+    return EXIT_SUCCESS;
+}
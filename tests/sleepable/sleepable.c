@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include <lrcu/lrcu.h>
+
+#include "../common/common.h"
+
+/*
+    LRCU_FLAVOR_SLEEPABLE: unregistered thread enters section and exits
+    without leaving it, another one leaves it with the returned index.
+*/
+
+static struct shared_data *shptr;
+static struct shared_data *seen;
+static int idx;
+
+static void *reader_enter(void *arg){
+    (void)arg;
+    idx = lrcu_read_lock_sleepable_ns(LRCU_NS_DEFAULT);
+    seen = lrcu_dereference(shptr);
+    return NULL;
+}
+
+static void *reader_leave(void *arg){
+    (void)arg;
+    LRCU_ASSERT(seen->c == 1);
+    lrcu_read_unlock_sleepable_ns(LRCU_NS_DEFAULT, idx);
+    return NULL;
+}
+
+static void run(void *(*fn)(void *)){
+    pthread_t tid;
+
+    pthread_create(&tid, NULL, fn, NULL);
+    pthread_join(tid, NULL);
+}
+
+int main(void){
+    struct shared_data *data;
+    int i;
+
+    if(__lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    if(lrcu_ns_init_flavor(LRCU_NS_DEFAULT, LRCU_FLAVOR_SLEEPABLE) == NULL)
+        return EXIT_FAILURE;
+
+    data = shared_data_constructor();
+    shptr = data;
+
+    run(reader_enter);
+    LRCU_ASSERT(seen == data);
+
+    lrcu_write_lock();
+    lrcu_assign_pointer(shptr, NULL);
+    lrcu_write_unlock();
+    lrcu_call(data, shared_data_destructor);
+
+    assert_held(&freed, 0);
+
+    run(reader_leave);
+    wait_for(&freed, 1);
+
+    /* nested sections in both epochs */
+    for(i = 0; i < 1000; i++){
+        int i1 = lrcu_read_lock_sleepable_ns(LRCU_NS_DEFAULT);
+        int i2 = lrcu_read_lock_sleepable_ns(LRCU_NS_DEFAULT);
+
+        lrcu_read_unlock_sleepable_ns(LRCU_NS_DEFAULT, i2);
+        lrcu_read_unlock_sleepable_ns(LRCU_NS_DEFAULT, i1);
+    }
+    lrcu_synchronize();
+
+    printf("sleepable: ok\n");
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include <lrcu/lrcu.h>
+
+#include "../common/common.h"
+
+/*
+    lrcu_synchronize_async: completion waits for the reader, event loop
+    learns about it through epoll on lrcu_eventfd().
+*/
+
+static struct shared_data *shptr;
+
+int main(int argc, char *argv[]){
+    int flavor = LRCU_FLAVOR_FENCE;
+    struct epoll_event ev = { .events = EPOLLIN };
+    struct shared_data *data;
+    pthread_t tid;
+    int efd, fd;
+    u64 cnt;
+
+    if(argc > 1)
+        flavor = atoi(argv[1]);
+
+    if(__lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    if(lrcu_ns_init_flavor(LRCU_NS_DEFAULT, flavor) == NULL)
+        return EXIT_FAILURE;
+
+    fd = lrcu_eventfd();
+    LRCU_ASSERT(fd >= 0);
+    LRCU_ASSERT(lrcu_eventfd() == fd);
+    efd = epoll_create1(0);
+    LRCU_ASSERT(efd >= 0);
+    ev.data.fd = fd;
+    LRCU_ASSERT(epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev) == 0);
+
+    data = shptr = shared_data_constructor();
+    section_enter(&tid, &shptr);
+
+    lrcu_write_lock();
+    lrcu_assign_pointer(shptr, NULL);
+    lrcu_write_unlock();
+    lrcu_synchronize_async(shared_data_destructor, data);
+
+    assert_held(&freed, 0);
+    leave = 1;
+
+    /* event loop */
+    while(!freed){
+        LRCU_ASSERT(epoll_wait(efd, &ev, 1, 10000) == 1);
+        LRCU_ASSERT(ev.data.fd == fd);
+        LRCU_ASSERT(read(fd, &cnt, sizeof(cnt)) == sizeof(cnt) && cnt > 0);
+    }
+    section_leave(tid);
+
+    close(efd);
+    printf("sync-async: ok\n");
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}
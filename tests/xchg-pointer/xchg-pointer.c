@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <lrcu/lrcu.h>
+
+#include "../common/common.h"
+
+/*
+    Writers publish into one namespace without any common lock: some with
+    lrcu_xchg_pointer, some with lrcu_cmpxchg_pointer loop. Readers must
+    never see a retired object.
+*/
+
+#define WRITERS 4
+#define READERS 2
+#define LOOPS 2000
+
+static struct shared_data *shptr;
+static volatile int flag = 1;
+
+static void *reader(void *arg){
+    struct shared_data *data;
+
+    (void)arg;
+    lrcu_thread_init();
+    while(flag){
+        lrcu_read_lock();
+        data = lrcu_dereference(shptr);
+        if(data)
+            LRCU_ASSERT(ACCESS_ONCE(data->c) == 1);
+        lrcu_read_unlock();
+    }
+    lrcu_thread_deinit();
+    return NULL;
+}
+
+static void *writer(void *arg){
+    long cas = (long)arg;
+    struct shared_data *data, *old;
+    int i;
+
+    for(i = 0; i < LOOPS; i++){
+        data = shared_data_constructor();
+        if(cas){
+            do{
+                old = ACCESS_ONCE(shptr);
+            }while(lrcu_cmpxchg_pointer(shptr, old, data) != old);
+        }else
+            old = lrcu_xchg_pointer(shptr, data);
+        if(old)
+            lrcu_call(old, shared_data_destructor);
+        /* lost increments would be seen as missing versions */
+        lrcu_write_barrier();
+        /* ticket locks convoy when writers outnumber cpus */
+        usleep(1);
+    }
+    return NULL;
+}
+
+int main(void){
+    pthread_t r[READERS], w[WRITERS];
+    u64 version;
+    long i;
+
+    if(__lrcu_init() == NULL)
+        return EXIT_FAILURE;
+    if(lrcu_ns_init(LRCU_NS_DEFAULT) == NULL)
+        return EXIT_FAILURE;
+    version = lrcu_get_state();
+
+    for(i = 0; i < READERS; i++)
+        pthread_create(&r[i], NULL, reader, NULL);
+    for(i = 0; i < WRITERS; i++)
+        pthread_create(&w[i], NULL, writer, (void *)(i & 1));
+    for(i = 0; i < WRITERS; i++)
+        pthread_join(w[i], NULL);
+    flag = 0;
+    for(i = 0; i < READERS; i++)
+        pthread_join(r[i], NULL);
+
+    LRCU_ASSERT(lrcu_get_state() >= version + WRITERS * LOOPS);
+    lrcu_call(shptr, shared_data_destructor);
+    lrcu_barrier();
+    LRCU_ASSERT(freed == WRITERS * LOOPS);
+
+    printf("xchg-pointer: ok\n");
+    lrcu_deinit();
+    return EXIT_SUCCESS;
+}